@@ -3,6 +3,7 @@
 #include "row.h"
 #include "mem_alloc.h"
 #include "index_hash.h"
+#include "index_simd.h"
 #include "index_btree.h"
 #include "thread.h"
 
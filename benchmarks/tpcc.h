@@ -11,6 +11,8 @@ class tpcc_query;
 #define IC3_TPCC_NEW_ORDER_PIECES   8
 #define IC3_TPCC_PAYMENT_PIECES     4
 #define IC3_TPCC_DELIVERY_PIECES    4
+// order lines of a NewOrder
+#define TPCC_MAX_OL_CNT             15
 
 class tpcc_wl : public workload {
 public:
@@ -80,6 +82,11 @@ private:
 	RC run_order_status(tpcc_query * query);
 	RC run_delivery(tpcc_query * query);
 	RC run_stock_level(tpcc_query * query);
+#if IDX_BATCH
+	// resolves the item and stock probes of all order lines in two batches,
+	// ERROR if an order line has an invalid item
+	RC new_order_batch(tpcc_query * query, itemid_t ** items, itemid_t ** stocks);
+#endif
 	bool has_local_row(row_t * location, access_t type, row_t * local, access_t local_type) {
 	    if (location == local) {
 	        if ((type == local_type) || (local_type == WR)) {
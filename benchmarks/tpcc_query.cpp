@@ -76,7 +76,7 @@ void tpcc_query::gen_new_order(uint64_t thd_id) {
   d_id = URand(1, DIST_PER_WARE, w_id-1);
   c_id = NURand(1023, 1, g_cust_per_dist, w_id-1);
   rbk = URand(1, 100, w_id-1);
-  ol_cnt = URand(5, 15, w_id-1);
+  ol_cnt = URand(5, TPCC_MAX_OL_CNT, w_id-1);
   o_entry_d = 2013;
   items = (Item_no *) _mm_malloc(sizeof(Item_no) * ol_cnt, 64);
   remote = false;
@@ -7,14 +7,20 @@
 #include "table.h"
 #include "row.h"
 #include "index_hash.h"
+#include "index_simd.h"
 #include "index_btree.h"
 #include "tpcc_const.h"
 
+#if BB_AUTORETIRE
+// retired by txn_man::get_row()
+#define RETIRE_ROW(row_cnt) {}
+#else
 #define RETIRE_ROW(row_cnt) { \
   access_cnt = row_cnt - 1; \
   if (retire_row(access_cnt) == Abort) \
     return finish(Abort); \
 }
+#endif
 
 void tpcc_txn_man::init(thread_t * h_thd, workload * h_wl, uint64_t thd_id) {
   txn_man::init(h_thd, h_wl, thd_id);
@@ -26,6 +32,9 @@ RC tpcc_txn_man::run_txn(base_query * query) {
 #if CC_ALG == IC3
   curr_type = m_query->type;
   curr_piece = 0;
+#elif CC_ALG == BAMBOO && BB_RO_FASTPATH
+  read_only = (m_query->type == TPCC_ORDER_STATUS ||
+               m_query->type == TPCC_STOCK_LEVEL);
 #endif
   switch (m_query->type) {
     case TPCC_PAYMENT :
@@ -100,9 +109,11 @@ warehouse_piece:
   assert(item != NULL);
   r_wh = ((row_t *)item->location);
 #if !COMMUTATIVE_OPS
-  r_wh_local = get_row(r_wh, WR);
+  r_wh_local = get_row(r_wh, WR, W_YTD);
+#elif CC_ALG == WOUND_WAIT || CC_ALG == BAMBOO
+  r_wh_local = get_row(r_wh, CM, W_YTD);
 #else
-  r_wh_local = get_row(r_wh, RD);
+  r_wh_local = get_row(r_wh, RD, W_YTD);
 #endif
   if (r_wh_local == NULL) {
     return finish(Abort);
@@ -122,6 +133,12 @@ warehouse_piece:
   RETIRE_ROW(row_cnt)
 #endif
   //get a copy of warehouse name
+#if CC_ALG == BAMBOO && BB_FIELD_LOCKING
+  r_wh_local = get_row(r_wh, RD, W_NAME);
+  if (r_wh_local == NULL) {
+    return finish(Abort);
+  }
+#endif
   tmp_str = r_wh_local->get_value(W_NAME);
   memcpy(w_name, tmp_str, 10);
   w_name[10] = '\0';
@@ -151,9 +168,11 @@ district_piece:
   assert(item != NULL);
   row_t * r_dist = ((row_t *)item->location);
 #if !COMMUTATIVE_OPS
-  row_t * r_dist_local = get_row(r_dist, WR);
+  row_t * r_dist_local = get_row(r_dist, WR, D_YTD);
+#elif CC_ALG == WOUND_WAIT || CC_ALG == BAMBOO
+  row_t * r_dist_local = get_row(r_dist, CM, D_YTD);
 #else
-  row_t * r_dist_local = get_row(r_dist, RD);
+  row_t * r_dist_local = get_row(r_dist, RD, D_YTD);
 #endif
   if (r_dist_local == NULL) {
     return finish(Abort);
@@ -166,6 +185,12 @@ district_piece:
 #endif
 #if (CC_ALG == BAMBOO) && (THREAD_CNT > 1) && !COMMUTATIVE_OPS
   RETIRE_ROW(row_cnt)
+#endif
+#if CC_ALG == BAMBOO && BB_FIELD_LOCKING
+  r_dist_local = get_row(r_dist, RD, D_NAME);
+  if (r_dist_local == NULL) {
+    return finish(Abort);
+  }
 #endif
   tmp_str = r_dist_local->get_value(D_NAME);
   memcpy(d_name, tmp_str, 10);
@@ -344,15 +369,20 @@ RC tpcc_txn_man::run_new_order(tpcc_query * query) {
   // order
   int sum=0;
   uint64_t ol_i_id;
+#if !IDX_BATCH
+  // the batched probes already resolved the stock rows
   uint64_t ol_supply_w_id;
+#endif
   uint64_t ol_quantity;
   row_t * r_item;
   row_t * r_item_local;
   row_t * r_stock;
   row_t * r_stock_local;
   int64_t i_price;
+#if !IDX_BATCH
   uint64_t stock_key;
   INDEX * stock_index;
+#endif
   itemid_t * stock_item;
   UInt64 s_quantity;
   int64_t s_remote_cnt;
@@ -375,6 +405,10 @@ RC tpcc_txn_man::run_new_order(tpcc_query * query) {
 #if IC3_MODIFIED_TPCC
   double tmp_value;
 #endif
+#if IDX_BATCH
+  itemid_t * items_batch[TPCC_MAX_OL_CNT];
+  itemid_t * stocks_batch[TPCC_MAX_OL_CNT];
+#endif
 
   /*=======================================================================+
   EXEC SQL SELECT c_discount, c_last, c_credit, w_tax
@@ -392,7 +426,7 @@ RC tpcc_txn_man::run_new_order(tpcc_query * query) {
   item = index_read(index, key, wh_to_part(w_id));
   assert(item != NULL);
   row_t * r_wh = ((row_t *)item->location);
-  row_t * r_wh_local = get_row(r_wh, RD);
+  row_t * r_wh_local = get_row(r_wh, RD, W_TAX);
   if (r_wh_local == NULL) {
     return finish(Abort);
   }
@@ -419,7 +453,13 @@ RC tpcc_txn_man::run_new_order(tpcc_query * query) {
   item = index_read(_wl->i_district, key, wh_to_part(w_id));
   assert(item != NULL);
   r_dist = ((row_t *)item->location);
-  r_dist_local = get_row(r_dist, WR);
+#if CC_ALG == BAMBOO && BB_FIELD_LOCKING
+  r_dist_local = get_row(r_dist, RD, D_TAX);
+  if (r_dist_local == NULL) {
+    return finish(Abort);
+  }
+#endif
+  r_dist_local = get_row(r_dist, WR, D_NEXT_O_ID);
   if (r_dist_local == NULL) {
     return finish(Abort);
   }
@@ -431,7 +471,7 @@ RC tpcc_txn_man::run_new_order(tpcc_query * query) {
   o_id ++;
   r_dist_local->set_value(D_NEXT_O_ID, o_id);
 
-#if CC_ALG == BAMBOO && (THREAD_CNT != 1)
+#if CC_ALG == BAMBOO && (THREAD_CNT != 1) && !BB_AUTORETIRE
   if (retire_row(row_cnt-1) == Abort)
       return finish(Abort);
 #endif
@@ -514,6 +554,10 @@ order_piece: // 4
 
 item_piece: // 5
   begin_piece(5);
+#if IDX_BATCH
+  if (new_order_batch(query, items_batch, stocks_batch) != RCOK)
+    return finish(ERROR);
+#endif
     /*===========================================+
     EXEC SQL SELECT i_price, i_name , i_data
         INTO :i_price, :i_name, :i_data
@@ -528,10 +572,16 @@ item_piece: // 5
     if (ol_i_id == 0)
       return finish(ERROR);
 #endif
+#if !IDX_BATCH
     ol_supply_w_id = query->items[ol_number].ol_supply_w_id;
+#endif
     ol_quantity = query->items[ol_number].ol_quantity;
     key = ol_i_id;
+#if IDX_BATCH
+    item = items_batch[ol_number];
+#else
     item = index_read(_wl->i_item, key, 0);
+#endif
     assert(item != NULL);
     r_item = ((row_t *)item->location);
     r_item_local = get_row(r_item, RD);
@@ -565,11 +615,15 @@ stock_piece: // 6
     +===============================================*/
   for (UInt32 ol_number = 0; ol_number < ol_cnt; ol_number++) {
     ol_i_id = query->items[ol_number].ol_i_id;
-    ol_supply_w_id = query->items[ol_number].ol_supply_w_id;
     ol_quantity = query->items[ol_number].ol_quantity;
+#if IDX_BATCH
+    stock_item = stocks_batch[ol_number];
+#else
+    ol_supply_w_id = query->items[ol_number].ol_supply_w_id;
     stock_key = stockKey(ol_i_id, ol_supply_w_id);
     stock_index = _wl->i_stock;
     index_read(stock_index, stock_key, wh_to_part(ol_supply_w_id), stock_item);
+#endif
     assert(stock_item != NULL);
     r_stock = ((row_t *)stock_item->location);
     r_stock_local = get_row(r_stock, WR);
@@ -679,6 +733,10 @@ orderline_piece: // 7
 
 #else // if CC_ALG != IC3
 
+#if IDX_BATCH
+  if (new_order_batch(query, items_batch, stocks_batch) != RCOK)
+    return finish(ERROR);
+#endif
   for (UInt32 ol_number = 0; ol_number < ol_cnt; ol_number++) {
         ol_i_id = query->items[ol_number].ol_i_id;
 #if TPCC_USER_ABORT
@@ -687,7 +745,6 @@ orderline_piece: // 7
         if (ol_i_id == 0)
           return finish(ERROR);
 #endif
-        ol_supply_w_id = query->items[ol_number].ol_supply_w_id;
         ol_quantity = query->items[ol_number].ol_quantity;
         /*===========================================+
         EXEC SQL SELECT i_price, i_name , i_data
@@ -696,7 +753,11 @@ orderline_piece: // 7
             WHERE i_id = :ol_i_id;
         +===========================================*/
         key = ol_i_id;
+#if IDX_BATCH
+        item = items_batch[ol_number];
+#else
         item = index_read(_wl->i_item, key, 0);
+#endif
         assert(item != NULL);
         r_item = ((row_t *)item->location);
         r_item_local = get_row(r_item, RD);
@@ -721,9 +782,14 @@ orderline_piece: // 7
             AND s_w_id = :ol_supply_w_id;
         +===============================================*/
 
+#if IDX_BATCH
+        stock_item = stocks_batch[ol_number];
+#else
+        ol_supply_w_id = query->items[ol_number].ol_supply_w_id;
         stock_key = stockKey(ol_i_id, ol_supply_w_id);
         stock_index = _wl->i_stock;
         index_read(stock_index, stock_key, wh_to_part(ol_supply_w_id), stock_item);
+#endif
         assert(item != NULL);
         r_stock = ((row_t *)stock_item->location);
         r_stock_local = get_row(r_stock, WR);
@@ -767,7 +833,7 @@ orderline_piece: // 7
         }
         r_stock_local->set_value(S_QUANTITY, &quantity);
 
-#if CC_ALG == BAMBOO && (THREAD_CNT != 1)
+#if CC_ALG == BAMBOO && (THREAD_CNT != 1) && !BB_AUTORETIRE
     if (retire_row(row_cnt-1) == Abort)
       return finish(Abort);
 #endif
@@ -831,6 +897,31 @@ orderline_piece: // 7
   return finish(rc);
 }
 
+#if IDX_BATCH
+RC tpcc_txn_man::new_order_batch(tpcc_query * query, itemid_t ** items,
+                                 itemid_t ** stocks) {
+  idx_key_t item_keys[TPCC_MAX_OL_CNT];
+  idx_key_t stock_keys[TPCC_MAX_OL_CNT];
+  int item_parts[TPCC_MAX_OL_CNT];
+  int stock_parts[TPCC_MAX_OL_CNT];
+  assert(query->ol_cnt <= TPCC_MAX_OL_CNT);
+  for (UInt32 ol_number = 0; ol_number < query->ol_cnt; ol_number++) {
+    uint64_t ol_i_id = query->items[ol_number].ol_i_id;
+    uint64_t ol_supply_w_id = query->items[ol_number].ol_supply_w_id;
+    // an invalid item has no index entry
+    if (ol_i_id == 0)
+      return ERROR;
+    item_keys[ol_number] = ol_i_id;
+    item_parts[ol_number] = 0;
+    stock_keys[ol_number] = stockKey(ol_i_id, ol_supply_w_id);
+    stock_parts[ol_number] = wh_to_part(ol_supply_w_id);
+  }
+  index_read_batch(_wl->i_item, item_keys, item_parts, query->ol_cnt, items);
+  index_read_batch(_wl->i_stock, stock_keys, stock_parts, query->ol_cnt, stocks);
+  return RCOK;
+}
+#endif
+
 RC
 tpcc_txn_man::run_order_status(tpcc_query * query) {
 /*	row_t * r_cust;
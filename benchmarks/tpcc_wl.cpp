@@ -5,6 +5,7 @@
 #include "thread.h"
 #include "table.h"
 #include "index_hash.h"
+#include "index_simd.h"
 #include "index_btree.h"
 #include "tpcc_helper.h"
 #include "row.h"
@@ -24,8 +25,8 @@ RC tpcc_wl::init() {
 	cout << "reading schema file: " << path << endl;
 	init_schema( path.c_str() );
 	cout << "TPCC schema initialized" << endl;
-	init_table();
 	next_tid = 0;
+	init_table();
 	ASSERT(g_perc_neworder >= 0);
 #if CC_ALG == IC3
 	init_scgraph();
@@ -44,6 +45,11 @@ RC tpcc_wl::init_schema(const char * schema_file) {
 	t_orderline = tables["ORDER-LINE"];
 	t_item = tables["ITEM"];
 	t_stock = tables["STOCK"];
+#if CC_ALG == BAMBOO && BB_FIELD_LOCKING
+	// hot tuples whose columns are updated by different transactions
+	t_warehouse->field_locking = true;
+	t_district->field_locking = true;
+#endif
 
 	i_item = indexes["ITEM_IDX"];
 	i_warehouse = indexes["WAREHOUSE_IDX"];
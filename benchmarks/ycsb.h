@@ -6,7 +6,23 @@
 #include "global.h"
 #include "helper.h"
 
+#if YCSB_PREFETCH_DIST > 0 && INDEX_STRUCT == IDX_BTREE
+#error "YCSB_PREFETCH_DIST only prefetches hash index buckets"
+#endif
+#if IDX_BATCH && YCSB_PREFETCH_DIST > 0
+#error "IDX_BATCH already resolves and prefetches all rows of a txn"
+#endif
+#if IDX_BATCH && INDEX_STRUCT == IDX_BTREE && WORKLOAD == YCSB
+#error "IDX_BATCH does not keep the index_next() position of each request"
+#endif
+#if YCSB_CHURN && !EPOCH_RECLAIM
+#error "YCSB_CHURN frees index nodes and rows that lookups may still walk"
+#endif
+// a long txn has MAX_ROW_PER_TXN requests
+#define YCSB_MAX_REQ (REQ_PER_QUERY > MAX_ROW_PER_TXN ? REQ_PER_QUERY : MAX_ROW_PER_TXN)
+
 class ycsb_query;
+class ycsb_request;
 
 class ycsb_wl : public workload {
 public :
@@ -17,6 +33,10 @@ public :
 	int key_to_part(uint64_t key);
 	INDEX * the_index;
 	table_t * the_table;
+#if YCSB_CHURN
+	// next key handed to a churned row
+	uint64_t volatile churn_key;
+#endif
 #if CC_ALG == IC3
 	SC_PIECE * get_cedges(TPCCTxnType type, int idx) {return NULL;};
 #endif
@@ -38,8 +58,18 @@ public:
 	void init(thread_t * h_thd, workload * h_wl, uint64_t part_id); 
 	RC run_txn(base_query * query);
 private:
+#if YCSB_PREFETCH_DIST > 0
+	void prefetch_bucket(ycsb_request * req);
+	itemid_t * prefetch_row(ycsb_request * req);
+#endif
 #if CC_ALG != BAMBOO
 	uint64_t row_cnt;
+#endif
+#if YCSB_CHURN
+	// inserts a row and deletes the one from YCSB_CHURN_DEPTH calls ago
+	void churn();
+	row_t * churn_rows[YCSB_CHURN_DEPTH];
+	uint64_t churn_cnt;
 #endif
 	ycsb_wl * _wl;
 };
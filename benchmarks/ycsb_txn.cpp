@@ -7,6 +7,7 @@
 #include "table.h"
 #include "row.h"
 #include "index_hash.h"
+#include "index_simd.h"
 #include "index_btree.h"
 #include "catalog.h"
 #include "manager.h"
@@ -18,7 +19,59 @@
 void ycsb_txn_man::init(thread_t * h_thd, workload * h_wl, uint64_t thd_id) {
     txn_man::init(h_thd, h_wl, thd_id);
     _wl = (ycsb_wl *) h_wl;
+#if YCSB_CHURN
+    for (uint32_t i = 0; i < YCSB_CHURN_DEPTH; i++)
+        churn_rows[i] = NULL;
+    churn_cnt = 0;
+#endif
+}
+
+#if YCSB_CHURN
+void ycsb_txn_man::churn() {
+    uint64_t part_id = get_thd_id() % g_part_cnt;
+    uint64_t key = ATOM_FETCH_ADD(_wl->churn_key, 1);
+    row_t * row = NULL;
+    uint64_t row_id = get_sys_clock();
+    __attribute__((unused)) RC rc = _wl->the_table->get_new_row(row, part_id, row_id);
+    assert(rc == RCOK);
+    row->set_primary_key(key);
+    row->set_value(0, &key);
+    // txn_man::index_insert() picks the partition by address, removal needs
+    // the row's own
+    itemid_t * m_item = (itemid_t *) mem_allocator.alloc(sizeof(itemid_t), part_id);
+    m_item->init();
+    m_item->type = DT_row;
+    m_item->location = row;
+    m_item->valid = true;
+    rc = _wl->the_index->index_insert(key, m_item, part_id);
+    assert(rc == RCOK);
+    uint32_t slot = churn_cnt % YCSB_CHURN_DEPTH;
+    row_t * old = churn_rows[slot];
+    if (old != NULL) {
+        rc = _wl->the_index->index_remove(old->get_primary_key(), old->get_part_id());
+        assert(rc == RCOK);
+        _wl->the_table->delete_row(old);
+    }
+    churn_rows[slot] = row;
+    churn_cnt ++;
+}
+#endif
+
+#if YCSB_PREFETCH_DIST > 0
+// slot of request rid among the requests resolved ahead
+#define PF_SLOT(rid) ((rid) % (YCSB_PREFETCH_DIST + 1))
+
+void ycsb_txn_man::prefetch_bucket(ycsb_request * req) {
+    _wl->the_index->prefetch(req->key, _wl->key_to_part(req->key));
+}
+
+itemid_t * ycsb_txn_man::prefetch_row(ycsb_request * req) {
+    itemid_t * item = index_read(_wl->the_index, req->key,
+                                 _wl->key_to_part(req->key));
+    __builtin_prefetch(item->location);
+    return item;
 }
+#endif
 
 RC ycsb_txn_man::run_txn(base_query * query) {
     RC rc;
@@ -26,8 +79,15 @@ RC ycsb_txn_man::run_txn(base_query * query) {
     ycsb_wl * wl = (ycsb_wl *) h_wl;
     itemid_t * m_item = NULL;
 #if CC_ALG == BAMBOO && (THREAD_CNT != 1)
+#if !BB_AUTORETIRE
     int access_id;
+#endif
+#if BB_ADAPTIVE_RETIRE
+    // every write asks the row whether to retire
+    retire_threshold = m_query->request_cnt;
+#else
     retire_threshold = (uint32_t) floor(m_query->request_cnt * (1 - g_last_retire));
+#endif
 #else
     row_cnt = 0;
 #endif
@@ -38,6 +98,38 @@ RC ycsb_txn_man::run_txn(base_query * query) {
         m_query->gen_requests(h_thd->get_thd_id(), h_wl);
         DEC_STATS(h_thd->get_thd_id(), run_time, get_sys_clock() - starttime);
     }
+#if CC_ALG == BAMBOO && BB_RO_FASTPATH
+    read_only = true;
+    for (uint32_t rid = 0; rid < m_query->request_cnt; rid ++) {
+        if (m_query->requests[rid].rtype == WR) {
+            read_only = false;
+            break;
+        }
+    }
+#endif
+#if YCSB_PREFETCH_DIST > 0
+    // requests up to YCSB_PREFETCH_DIST ahead are resolved and their rows
+    // are in flight, the buckets of the next YCSB_PREFETCH_DIST are loading
+    itemid_t * items_ahead[YCSB_PREFETCH_DIST + 1];
+    for (uint32_t rid = 0; rid < 2 * YCSB_PREFETCH_DIST
+         && rid < m_query->request_cnt; rid ++)
+        prefetch_bucket(&m_query->requests[rid]);
+    for (uint32_t rid = 0; rid < YCSB_PREFETCH_DIST
+         && rid < m_query->request_cnt; rid ++)
+        items_ahead[PF_SLOT(rid)] = prefetch_row(&m_query->requests[rid]);
+#elif IDX_BATCH
+    // all probes are resolved in one batch, their rows are requested
+    itemid_t * items_batch[YCSB_MAX_REQ];
+    idx_key_t keys_batch[YCSB_MAX_REQ];
+    int parts_batch[YCSB_MAX_REQ];
+    assert(m_query->request_cnt <= YCSB_MAX_REQ);
+    for (uint32_t rid = 0; rid < m_query->request_cnt; rid ++) {
+        keys_batch[rid] = m_query->requests[rid].key;
+        parts_batch[rid] = wl->key_to_part(keys_batch[rid]);
+    }
+    index_read_batch(_wl->the_index, keys_batch, parts_batch,
+                     m_query->request_cnt, items_batch);
+#endif
 
     for (uint32_t rid = 0; rid < m_query->request_cnt; rid ++) {
         ycsb_request * req = &m_query->requests[rid];
@@ -46,7 +138,26 @@ RC ycsb_txn_man::run_txn(base_query * query) {
         UInt32 iteration = 0;
         while ( !finish_req ) {
             if (iteration == 0) {
+#if YCSB_PREFETCH_DIST > 0
+                uint32_t next = rid + YCSB_PREFETCH_DIST;
+                if (next + YCSB_PREFETCH_DIST < m_query->request_cnt)
+                    prefetch_bucket(&m_query->requests[next + YCSB_PREFETCH_DIST]);
+                if (next < m_query->request_cnt)
+                    items_ahead[PF_SLOT(next)] = prefetch_row(&m_query->requests[next]);
+                m_item = items_ahead[PF_SLOT(rid)];
+#if YCSB_PREFETCH_DIST > 1 && CC_ALG != HSTORE
+                // the next row arrived by now, load its manager and data
+                if (rid + 1 < m_query->request_cnt) {
+                    row_t * next_row = (row_t *) items_ahead[PF_SLOT(rid + 1)]->location;
+                    __builtin_prefetch(next_row->manager, 1);
+                    __builtin_prefetch(next_row->data);
+                }
+#endif
+#elif IDX_BATCH
+                m_item = items_batch[rid];
+#else
                 m_item = index_read(_wl->the_index, req->key, part_id);
+#endif
             }
 #if INDEX_STRUCT == IDX_BTREE
             else {
@@ -64,7 +175,7 @@ RC ycsb_txn_man::run_txn(base_query * query) {
                 rc = Abort;
                 goto final;
             }
-#if CC_ALG == BAMBOO && (THREAD_CNT != 1)
+#if CC_ALG == BAMBOO && (THREAD_CNT != 1) && !BB_AUTORETIRE
             access_id = row_cnt - 1;
 #endif
 
@@ -81,12 +192,18 @@ RC ycsb_txn_man::run_txn(base_query * query) {
                     assert(req->rtype == WR);
 //					for (int fid = 0; fid < schema->get_field_cnt(); fid++) {
                         int fid = 0;
-#if (CC_ALG == BAMBOO) || (CC_ALG == WOUND_WAIT)
+#if CC_ALG == BAMBOO
+                        // mark the field dirty in the access
+                        uint64_t fval = 0;
+                        row_local->set_value(fid, &fval, sizeof(fval));
+#else
+#if CC_ALG == WOUND_WAIT
                         char * data = row_local->get_data();
 #else
                         char * data = row->get_data();
 #endif
                         *(uint64_t *)(&data[fid * 10]) = 0;
+#endif
 //					}
                 } 
             }
@@ -95,7 +212,7 @@ RC ycsb_txn_man::run_txn(base_query * query) {
             iteration ++;
             if (req->rtype == RD || req->rtype == WR || iteration == req->scan_len)
                 finish_req = true;
-#if (CC_ALG == BAMBOO) && (THREAD_CNT != 1)
+#if (CC_ALG == BAMBOO) && (THREAD_CNT != 1) && !BB_AUTORETIRE
             // retire write txn
             if (finish_req && (req->rtype == WR) && (rid <= retire_threshold)) {
             	//printf("[txn-%lu] retire %d requests\n", get_txn_id(), rid);
@@ -108,6 +225,10 @@ RC ycsb_txn_man::run_txn(base_query * query) {
     rc = RCOK;
 final:
     rc = finish(rc);
+#if YCSB_CHURN
+    if (rc == RCOK)
+        churn();
+#endif
     return rc;
 }
 
@@ -7,6 +7,7 @@
 #include "table.h"
 #include "row.h"
 #include "index_hash.h"
+#include "index_simd.h"
 #include "index_btree.h"
 #include "catalog.h"
 #include "manager.h"
@@ -23,6 +24,9 @@ RC ycsb_wl::init() {
 	next_tid = 0;
 	string path = "./benchmarks/YCSB_schema.txt";
 	init_schema( path );
+#if YCSB_CHURN
+	churn_key = g_synth_table_size;
+#endif
 	
 	init_table_parallel();
 //	init_table();
@@ -68,7 +72,7 @@ RC ycsb_wl::init_table() {
 				new_row->set_value(fid, value);
 			}
             itemid_t * m_item = 
-                (itemid_t *) mem_allocator.alloc( sizeof(itemid_t), part_id );
+                (itemid_t *) mem_allocator.alloc_load( sizeof(itemid_t), part_id );
 			assert(m_item != NULL);
             m_item->type = DT_row;
             m_item->location = new_row;
@@ -140,7 +144,7 @@ void * ycsb_wl::init_table_slice() {
 		}
 
 		itemid_t * m_item =
-			(itemid_t *) mem_allocator.alloc( sizeof(itemid_t), part_id );
+			(itemid_t *) mem_allocator.alloc_load( sizeof(itemid_t), part_id );
 		assert(m_item != NULL);
 		m_item->type = DT_row;
 		m_item->location = new_row;
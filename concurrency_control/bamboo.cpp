@@ -3,20 +3,71 @@
 //
 #include "txn.h"
 #include "row.h"
+#include "catalog.h"
 #include "row_bamboo.h"
 //#include "row_bamboo_pt.h"
+#if BB_SPIN_PARK
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 #if CC_ALG == BAMBOO
 RC
 txn_man::retire_row(int access_cnt){
+#if BB_ADAPTIVE_RETIRE
+  // cold rows or rows whose retired writes cascade aborts hold the lock
+  // until commit
+  Access * access = accesses[access_cnt];
+  if (!access->orig_row->get_manager(access)->should_retire()) {
+    INC_STATS(get_thd_id(), retire_skip_cnt, 1);
+    return RCOK;
+  }
+  INC_STATS(get_thd_id(), retire_cnt, 1);
+#endif
   return accesses[access_cnt]->orig_row->retire_row(accesses[access_cnt]->lock_entry);
 }
+
+#if BB_UNDO_LOG
+// called before column fid of the local copy is overwritten
+void
+txn_man::log_undo(Access * access, int fid) {
+  if (fid < 64) {
+    if (access->undo_fields & (1UL << fid))
+      return;
+    access->undo_fields |= 1UL << fid;
+  }
+  uint64_t size = access->data->get_schema()->get_field_size(fid);
+  UndoRec * rec = (UndoRec *) alloc_row_buf(sizeof(UndoRec) + size, 8);
+  rec->prev = access->undo;
+  rec->fid = fid;
+  memcpy(rec + 1, access->data->get_value_plain(fid), size);
+  access->undo = rec;
+}
+#endif
+
+#if BB_RO_FASTPATH
+// abort if a write committed on any row since it was copied
+RC
+txn_man::validate_read_only() {
+  for (int rid = 0; rid < row_cnt; rid++) {
+    Access * access = accesses[rid];
+    if (access->type == WR)
+      continue;
+    if (!access->orig_row->get_manager(access)->snapshot_valid(this, access))
+      return Abort;
+  }
+  return RCOK;
+}
+#endif
 #endif
 
 void
 txn_man::decrement_commit_barriers() {
     //ATOM_SUB(*addr_barriers, 1UL << 2);
     ATOM_SUB(commit_barriers, 1UL << 2);
+#if CC_ALG == BAMBOO && BB_SPIN_PARK
+    wakeup();
+#endif
 }
 
 void
@@ -24,3 +75,34 @@ txn_man::increment_commit_barriers() {
     //ATOM_ADD(*addr_barriers, 1UL << 2);
     ATOM_ADD(commit_barriers, 1UL << 2);
 }
+
+#if CC_ALG == BAMBOO && BB_SPIN_PARK
+// spin for BB_SPIN_CNT rounds, then sleep until wakeup() bumps wake_seq.
+// parked threads recheck after g_timeout so timed waits still expire.
+void
+txn_man::spin_or_park(uint64_t & spins, uint32_t & seq) {
+    if (spins < BB_SPIN_CNT) {
+        spins++;
+        PAUSE
+    } else {
+        parked = true;
+        __sync_synchronize();
+        if (wake_seq == seq) {
+            struct timespec timeout = {0, (long) g_timeout};
+            syscall(SYS_futex, &wake_seq, FUTEX_WAIT_PRIVATE, seq, &timeout,
+                    NULL, 0);
+        }
+        parked = false;
+    }
+    seq = wake_seq;
+    COMPILER_BARRIER
+}
+
+// called after changing commit_barriers, lock_ready or lock_abort
+void
+txn_man::wakeup() {
+    ATOM_ADD(wake_seq, 1);
+    if (parked)
+        syscall(SYS_futex, &wake_seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#endif
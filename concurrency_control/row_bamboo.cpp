@@ -3,9 +3,14 @@
 #include "row_bamboo.h"
 #include "mem_alloc.h"
 #include "manager.h"
+#include "thread.h"
 
-void Row_bamboo::init(row_t * row) {
+#if CC_ALG == BAMBOO
+void Row_bamboo::init(row_t * row, int fid) {
     _row = row;
+#if BB_FIELD_LOCKING
+    _fid = fid;
+#endif
     // owners contains at most one lock entry, whose type is always LOCK_EX
     owners = NULL;
     // waiter is a doubly linked list
@@ -14,8 +19,25 @@ void Row_bamboo::init(row_t * row) {
     // retired is a doubly linked list
     retired_head = NULL;
     retired_tail = NULL;
+#if BB_RETIRED_WR_INDEX
+    retired_wr_head = NULL;
+    retired_wr_tail = NULL;
+#endif
     waiter_cnt = 0;
     retired_cnt = 0;
+#if COMMUTATIVE_OPS
+    com_owners = NULL;
+#endif
+#if BB_RO_FASTPATH
+    commit_cnt = 0;
+#endif
+#if CORO_PER_THREAD > 1
+    wounded_wr_cnt = 0;
+#endif
+#if BB_ADAPTIVE_RETIRE
+    conflict_score = 0;
+    cascade_score = 0;
+#endif
     // init latches
 #if LATCH == LH_SPINLOCK
     latch = new pthread_spinlock_t;
@@ -23,6 +45,11 @@ void Row_bamboo::init(row_t * row) {
 #elif LATCH == LH_MUTEX
     latch = new pthread_mutex_t;
     pthread_mutex_init(latch, NULL);
+#elif LATCH == LH_LOCKFREE
+    latch = new pthread_spinlock_t;
+    pthread_spin_init(latch, PTHREAD_PROCESS_SHARED);
+    assert(g_thread_cnt < 64);
+    fast_readers = 0;
 #else
     latch = new mcslock();
 #endif
@@ -35,7 +62,7 @@ void Row_bamboo::lock(txn_man * txn) {
             if (unlikely(g_central_man))
                 glob_manager->lock_row(_row);
             else {
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
                pthread_spin_lock( latch );
 #elif LATCH == LH_MUTEX
                 pthread_mutex_lock( latch );
@@ -52,7 +79,7 @@ void Row_bamboo::unlock(txn_man * txn) {
             if (unlikely(g_central_man))
                 glob_manager->release_row(_row);
             else {
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
                 pthread_spin_unlock( latch );
 #elif LATCH == LH_MUTEX
                 pthread_mutex_unlock( latch );
@@ -79,16 +106,42 @@ RC Row_bamboo::lock_get(lock_t type, txn_man * txn, Access * access) {
 #if PF_MODEL
     INC_STATS(txn->get_thd_id(), lock_acquire_cnt, 1);
 #endif
+#if LATCH == LH_LOCKFREE
+    // no conflicting entries: read committed data without the latch
+    if (type == LOCK_SH && fast_read_get(txn)) {
+        to_insert->status = LOCK_FASTPATH;
+        txn->lock_ready = true;
+#if PF_MODEL
+        INC_STATS(txn->get_thd_id(), lock_directly_cnt, 1);
+#endif
+        return RCOK;
+    }
+#endif
 #if PF_CS
     uint64_t starttime = get_sys_clock();
 #endif
     // take the latch
     lock(txn);
     COMPILER_BARRIER
+#if CORO_PER_THREAD > 1
+    // come back once wounded writes have left, as if arriving later
+    while (wounded_wr_cnt > 0) {
+        unlock(txn);
+        txn->h_thd->yield();
+        if (txn->lock_abort)
+            return Abort;
+        lock(txn);
+        COMPILER_BARRIER
+    }
+#endif
 #if PF_CS
     uint64_t endtime = get_sys_clock();
     INC_STATS(txn->get_thd_id(), time_get_latch, endtime - starttime);
     starttime = endtime;
+#endif
+#if BB_ADAPTIVE_RETIRE
+    BB_UPDATE_SCORE(conflict_score, retired_cnt + waiter_cnt + (owners? 1 : 0));
+    BB_UPDATE_SCORE(cascade_score, 0);
 #endif
     // timestamp
     ts_t ts = 0;
@@ -100,6 +153,12 @@ RC Row_bamboo::lock_get(lock_t type, txn_man * txn, Access * access) {
         txn->set_next_ts(1);
         ts = txn->get_ts();
     }
+#endif
+#if COMMUTATIVE_OPS
+    if (com_owners) {
+        rc = com_lock_get(to_insert, txn);
+        goto final;
+    }
 #endif
     if (type == LOCK_SH) {
         // if read, decide if need to wait
@@ -179,6 +238,13 @@ RC Row_bamboo::lock_get(lock_t type, txn_man * txn, Access * access) {
 				rc = Abort;
 				goto final;
 			}
+#if BB_MAX_DEPTH > 0
+            if (too_deep(retired_tail, txn)) {
+                add_to_waiters(ts, to_insert);
+                rc = WAIT;
+                goto final;
+            }
+#endif
             UPDATE_RETIRE_INFO(to_insert, retired_tail);
             ADD_TO_RETIRED_TAIL(to_insert);
 #if PF_CS
@@ -190,9 +256,31 @@ RC Row_bamboo::lock_get(lock_t type, txn_man * txn, Access * access) {
             //goto final; // no owner -> no waiter, no need to promote
 #endif
         }
-    } else { // LOCK_EX
+    } else { // LOCK_EX or LOCK_COM
+#if LATCH == LH_LOCKFREE
+        // a read of self taken without the latch is covered by this request,
+        // writers must not wait for it
+        uint64_t self_bit = 1UL << txn->get_thd_id();
+        if (fast_readers & self_bit)
+            drop_fast_reader(self_bit);
+        // from now on the set of fast readers can only shrink
+        uint64_t readers = ATOM_FETCH_OR(fast_readers, BB_FAST_CLOSED) &
+            ~BB_FAST_CLOSED;
+#endif
         // grab directly, no ts needed
+#if LATCH == LH_LOCKFREE
+        if (!retired_head && !owners && !readers) {
+#else
         if (!retired_head && !owners) {
+#endif
+#if COMMUTATIVE_OPS
+            if (type == LOCK_COM) {
+                to_insert->status = LOCK_OWNER;
+                STACK_PUSH(com_owners, to_insert);
+                txn->lock_ready = true;
+                goto final;
+            }
+#endif
             owners = to_insert;
             owners->status = LOCK_OWNER;
             owners->txn->lock_ready = true;
@@ -233,6 +321,13 @@ RC Row_bamboo::lock_get(lock_t type, txn_man * txn, Access * access) {
                     }
                     ts = assign_ts(ts, txn);
                 } // else [][][] -> no need to assign self
+#if LATCH == LH_LOCKFREE
+                // readers that came in without the latch are ahead of self
+                if (readers) {
+                    assign_fast_readers_ts(readers);
+                    ts = assign_ts(ts, txn);
+                }
+#endif
             }
         } else {
 			// self is assigned but txns in the list may not be assigned
@@ -248,6 +343,10 @@ RC Row_bamboo::lock_get(lock_t type, txn_man * txn, Access * access) {
               rc = Abort;
               goto final;
         }
+#if LATCH == LH_LOCKFREE
+        if (readers)
+            wound_fast_readers(ts, to_insert, readers);
+#endif
         // wound owners
         if (owners && (owner_ts == 0 || a_higher_than_b(ts, owner_ts))) {
             if (wound_owner(to_insert) == Abort) {
@@ -301,14 +400,19 @@ RC Row_bamboo::lock_retire(BBLockEntry * entry) {
     if (entry->status == LOCK_OWNER) {
         // move to retired list
         RETIRE_ENTRY(entry);
+#if CORO_PER_THREAD > 1
+        count_if_wounded(entry);
+#endif
         // make dirty data globally visible
         if (entry->type == LOCK_EX) {
 #if PF_CS
             uint64_t startt = get_sys_clock();
-            entry->access->orig_row->copy(entry->access->data);
+            copy_data(entry->access->orig_row, entry->access->data,
+                entry->access->dirty_fields);
             INC_STATS(entry->txn->get_thd_id(), time_copy, get_sys_clock() - startt);
 #else
-            entry->access->orig_row->copy(entry->access->data);
+            copy_data(entry->access->orig_row, entry->access->data,
+                entry->access->dirty_fields);
 #endif
         }
     } else {
@@ -330,6 +434,12 @@ RC Row_bamboo::lock_retire(BBLockEntry * entry) {
 RC Row_bamboo::lock_release(BBLockEntry * entry, RC rc) {
 	if (entry->status == LOCK_DROPPED)
 	    return RCOK;
+#if LATCH == LH_LOCKFREE
+    if (entry->status == LOCK_FASTPATH) {
+        fast_read_release(entry);
+        return RCOK;
+    }
+#endif
 #if PF_ABORT 
     entry->txn->abort_chain = 0;
 #endif
@@ -342,24 +452,36 @@ RC Row_bamboo::lock_release(BBLockEntry * entry, RC rc) {
     uint64_t endtime = get_sys_clock();
     INC_STATS(entry->txn->get_thd_id(), time_release_latch, endtime- starttime);
     starttime = endtime;
+#endif
+#if BB_RO_FASTPATH
+    if (rc != Abort && entry->type != LOCK_SH && (entry->status ==
+        LOCK_RETIRED || entry->status == LOCK_OWNER))
+        commit_cnt++;
 #endif
     // if in retired
     if (entry->status == LOCK_RETIRED) {
         rm_from_retired(entry, rc == Abort, entry->txn);
+#if COMMUTATIVE_OPS
+    } else if (entry->status == LOCK_OWNER && entry->type == LOCK_COM) {
+        // the delta was added to the row by txn_man::cleanup()
+        rm_from_com_owners(entry);
+#endif
     } else if (entry->status == LOCK_OWNER) {
         owners = NULL;
         // not found in retired, need to make globally visible if rc = commit
         if (rc == RCOK && (entry->type == LOCK_EX)) {
 #if PF_CS
                 uint64_t startt = get_sys_clock();
-                entry->access->orig_row->copy(entry->access->data);
+                copy_data(entry->access->orig_row, entry->access->data,
+                entry->access->dirty_fields);
                 INC_STATS(entry->txn->get_thd_id(), time_copy, get_sys_clock() - startt);
 #else
-                entry->access->orig_row->copy(entry->access->data);
+                copy_data(entry->access->orig_row, entry->access->data,
+                entry->access->dirty_fields);
 #endif
         }
     } else if (entry->status == LOCK_WAITER) {
-#if DEBUG_BAMBOO 
+#if DEBUG_BAMBOO && !BB_WAITER_HEAP
 		UInt32 cnt = 0;
 		BBLockEntry * en = waiters_head;
 		bool found = false;
@@ -373,10 +495,10 @@ RC Row_bamboo::lock_release(BBLockEntry * entry, RC rc) {
 		assert(found);
 		assert(cnt == waiter_cnt);
 		assert(cnt != 0);
-        LIST_RM(waiters_head, waiters_tail, entry, waiter_cnt);
+        rm_from_waiters(entry);
 		assert(waiter_cnt == cnt-1);
 #else
-        LIST_RM(waiters_head, waiters_tail, entry, waiter_cnt);
+        rm_from_waiters(entry);
 #endif
     } else {
 		// already removed
@@ -385,7 +507,14 @@ RC Row_bamboo::lock_release(BBLockEntry * entry, RC rc) {
     if (!owners) {
         bring_next(NULL);
     }
+#if LATCH == LH_LOCKFREE
+    reopen_fast_path();
+    assert(owners || retired_head || has_fast_readers() || (waiter_cnt == 0));
+#elif COMMUTATIVE_OPS
+    assert(owners || retired_head || com_owners || (waiter_cnt == 0));
+#else
     assert(owners || retired_head || (waiter_cnt == 0));
+#endif
     // WAIT - done releasing with is_abort = true
     // FINISH - done releasing with is_abort = false
 #if PF_CS
@@ -412,47 +541,130 @@ bool Row_bamboo::bring_next(txn_man * txn) {
 #endif
     bool has_txn = false;
     BBLockEntry * entry = waiters_head;
+#if !BB_WAITER_HEAP
     BBLockEntry * next = NULL;
-#if BB_AUTORETIRE
-    bool retired_has_write = (retired_tail && (retired_tail->type == LOCK_EX || !retired_tail->is_cohead));
 #endif
     // If any waiter can join the owners, just do it
     while (entry) {
+#if !BB_WAITER_HEAP
 		// XXX(zhihan): entry may not be waiters_head 
 		next = entry->next;
+#endif
         if (!owners) {
+#if COMMUTATIVE_OPS
+            // increment-only holders only admit their own kind
+            if (com_owners && entry->type != LOCK_COM)
+                break;
+#endif
+#if BB_MAX_DEPTH > 0
+            // wait for the chain of dirty writes to shrink
+            if (too_deep(retired_tail, entry->txn))
+                break;
+#endif
             if (entry->type == LOCK_EX) { // !owners
-#if BB_AUTORETIRE
-                printf("ERROR: not support AUTORETIRE yet\n");
-#else
-                // add to owners
+#if LATCH == LH_LOCKFREE
+                // writers wait until readers admitted without the latch leave
+                if (has_fast_readers())
+                    break;
+#endif
+                // add to owners. with BB_AUTORETIRE it is retired once the
+                // txn moves on to its next row
                 owners = entry;
                 entry->status = LOCK_OWNER;
                 UPDATE_RETIRE_INFO(owners, retired_tail);
                 has_txn = bring_out_waiter(entry, txn);
-#endif
                 break;
+#if COMMUTATIVE_OPS
+            } else if (entry->type == LOCK_COM) {
+                // increments are added to the committed row, wait for the
+                // retired entries to leave
+                if (retired_head)
+                    break;
+                if (bring_out_waiter(entry, txn))
+                    has_txn = true;
+                entry->status = LOCK_OWNER;
+                STACK_PUSH(com_owners, entry);
+#endif
             } else {
-#if BB_AUTORETIRE && !BB_ALWAYS_RETIRED
-                printf("ERROR: not support AUTORETIRE yet\n");
-#else
                 // add to retired
                 UPDATE_RETIRE_INFO(entry, retired_tail);
                 has_txn = bring_out_waiter(entry, txn);
                 ADD_TO_RETIRED_TAIL(entry);
-#endif
             }
+#if BB_WAITER_HEAP
+			// the new root is the next waiter in ts order
+			entry = waiters_head;
+#else
 			entry = next;
+#endif
         } else
             break; // no promotable waiters
     }
+#if LATCH == LH_LOCKFREE
+    assert(owners || retired_head || has_fast_readers() || (waiter_cnt == 0));
+#elif COMMUTATIVE_OPS
+    assert(owners || retired_head || com_owners || (waiter_cnt == 0));
+#else
     assert(owners || retired_head || (waiter_cnt == 0));
+#endif
 #if DEBUG_BAMBOO
     check_correctness();
 #endif
     return has_txn;
 }
 
+#if COMMUTATIVE_OPS
+// called with com_owners not empty, so owners and retired are empty. a
+// LOCK_COM request joins unless others wait for the holders to leave; any
+// other request wounds the holders with lower priority and waits.
+RC Row_bamboo::com_lock_get(BBLockEntry * to_insert, txn_man * txn) {
+    if (to_insert->type == LOCK_COM && !waiters_head) {
+        to_insert->status = LOCK_OWNER;
+        STACK_PUSH(com_owners, to_insert);
+        txn->lock_ready = true;
+        return RCOK;
+    }
+    if (to_insert->type != LOCK_COM) {
+        BBLockEntry * en;
+        for (en = com_owners; en; en = en->next)
+            assign_ts(0, en->txn);
+        ts_t ts = assign_ts(txn->get_ts(), txn);
+        BBLockEntry * prev = NULL;
+        en = com_owners;
+        while (en) {
+            BBLockEntry * next = en->next;
+            if (a_higher_than_b(ts, en->txn->get_ts()) &&
+                txn->wound_txn(en->txn) != COMMITED) {
+                if (prev)
+                    prev->next = next;
+                else
+                    com_owners = next;
+                return_entry(en);
+            } else
+                prev = en;
+            en = next;
+        }
+    }
+    add_to_waiters(assign_ts(txn->get_ts(), txn), to_insert);
+    if (!com_owners && bring_next(txn))
+        return RCOK;
+    return WAIT;
+}
+
+void Row_bamboo::rm_from_com_owners(BBLockEntry * entry) {
+    BBLockEntry * prev = NULL;
+    BBLockEntry * en = com_owners;
+    while (en != entry) {
+        prev = en;
+        en = en->next;
+    }
+    if (prev)
+        prev->next = entry->next;
+    else
+        com_owners = entry->next;
+}
+#endif
+
 // return next lock entry in the retired list after removing en (and its
 // descendants if is_abort = true)
 inline
@@ -468,6 +680,7 @@ BBLockEntry * Row_bamboo::rm_from_retired(BBLockEntry * en, bool is_abort, txn_m
         if (retired_cnt == 0)
           printf("error!\n");
         LIST_RM(retired_head, retired_tail, en, retired_cnt);
+        WR_INDEX_RM(en);
         return_entry(en);
         return next;
     }
@@ -565,8 +778,12 @@ txn) {
     assert(en->type == LOCK_EX);
     BBLockEntry * prev = en->prev;
     BBLockEntry * to_return;
+#if BB_ADAPTIVE_RETIRE
+    UInt32 aborted_cnt = owners? 1 : 0;
+#endif
     // abort till end, no need to update barrier as set abort anyway
     LIST_RM_SINCE(retired_head, retired_tail, en);
+    WR_INDEX_RM_SINCE(en);
     while(en) {
         en->txn->set_abort(true);
         to_return = en;
@@ -578,7 +795,13 @@ txn) {
 #endif
         en = en->next;
         return_entry(to_return);
+#if BB_ADAPTIVE_RETIRE
+        aborted_cnt++;
+#endif
     }
+#if BB_ADAPTIVE_RETIRE
+    BB_UPDATE_SCORE(cascade_score, aborted_cnt);
+#endif
     // empty owners
     if (owners) {
 #if PF_ABORT 
@@ -600,10 +823,16 @@ inline
 RC Row_bamboo::insert_read_to_retired(BBLockEntry * to_insert, ts_t ts, 
 				Access * access) {
 	RC rc = RCOK;
-	BBLockEntry * en = retired_head;
+	BBLockEntry * en = FIRST_RETIRED_WR;
     // TODO: handle case if en is committed. 
-	for (UInt32 i = 0; i < retired_cnt; i++) {
+	while (en) {
 		if ((en->type == LOCK_EX) && (en->txn->get_ts() > ts)) {
+#if BB_MAX_DEPTH > 0
+            if (too_deep(en->prev, to_insert->txn)) {
+                add_to_waiters(ts, to_insert);
+                return WAIT;
+            }
+#endif
             // increment barrier anyway. if is not cohead, decrement the barrier
             en->txn->increment_commit_barriers();
             // compiler barrier
@@ -618,7 +847,7 @@ RC Row_bamboo::insert_read_to_retired(BBLockEntry * to_insert, ts_t ts,
 			    break;
             }
 		}
-		en = en->next;
+		en = NEXT_RETIRED_WR(en);
 	}
 	if (en) {
         assert(ts != 0);
@@ -630,16 +859,26 @@ RC Row_bamboo::insert_read_to_retired(BBLockEntry * to_insert, ts_t ts,
 		to_insert->txn->lock_ready = true;
 #if PF_CS
         uint64_t startt = get_sys_clock();
-        access->data->copy(en->access->orig_data);
-        INC_STATS(to_insert->txn->get_thd_id(), time_copy, get_sys_clock() - startt);
+#endif
+#if BB_UNDO_LOG
+        read_before(access->data, en);
 #else
-        access->data->copy(en->access->orig_data);
+        copy_data(access->data, en->access->orig_data);
+#endif
+#if PF_CS
+        INC_STATS(to_insert->txn->get_thd_id(), time_copy, get_sys_clock() - startt);
 #endif
 		rc = FINISH;
 #if DBEUG_BAMBOO
         check_correctness();
 #endif
 	} else {
+#if BB_MAX_DEPTH > 0
+        if (too_deep(retired_tail, to_insert->txn)) {
+            add_to_waiters(ts, to_insert);
+            return WAIT;
+        }
+#endif
 		if (owners) {
             // insert before owners. 
             assert(ts != 0);
@@ -656,10 +895,15 @@ RC Row_bamboo::insert_read_to_retired(BBLockEntry * to_insert, ts_t ts,
                 retired_cnt++; 
 #if PF_CS
                 uint64_t startt = get_sys_clock();
-                access->data->copy(owners->access->orig_data);
-                INC_STATS(to_insert->txn->get_thd_id(), time_copy, get_sys_clock() - startt);
+#endif
+#if BB_UNDO_LOG
+                // the owner has not published its writes yet
+                copy_data(access->data, _row);
 #else
-                access->data->copy(owners->access->orig_data);
+                copy_data(access->data, owners->access->orig_data);
+#endif
+#if PF_CS
+                INC_STATS(to_insert->txn->get_thd_id(), time_copy, get_sys_clock() - startt);
 #endif
                 to_insert->txn->lock_ready = true;
                 rc = FINISH;
@@ -711,6 +955,153 @@ RC Row_bamboo::insert_read_to_retired(BBLockEntry * to_insert, ts_t ts,
 	return rc;
 }
 
+#if LATCH == LH_LOCKFREE
+// try to take a shared lock by setting the thread's reader bit. only succeeds
+// while no conflicting request has closed the fast path, in which case the row
+// holds committed data only.
+bool Row_bamboo::fast_read_get(txn_man * txn) {
+    uint64_t bit = 1UL << txn->get_thd_id();
+    uint64_t local = fast_readers;
+    while (!(local & BB_FAST_CLOSED)) {
+        if (ATOM_CAS(fast_readers, local, local | bit))
+            return true;
+        local = fast_readers;
+    }
+    return false;
+}
+
+// readers leave an open row without the latch. once a writer has closed the
+// row, bits are only cleared under the latch so that the writer holding it
+// sees exactly the readers still inside their txns.
+void Row_bamboo::fast_read_release(BBLockEntry * entry) {
+    txn_man * txn = entry->txn;
+    uint64_t bit = 1UL << txn->get_thd_id();
+    uint64_t local = fast_readers;
+    return_entry(entry);
+    while (!(local & BB_FAST_CLOSED)) {
+        if (ATOM_CAS(fast_readers, local, local & ~bit))
+            return;
+        local = fast_readers;
+    }
+    lock(txn);
+    COMPILER_BARRIER
+    drop_fast_reader(bit);
+    COMPILER_BARRIER
+    unlock(txn);
+}
+
+// must hold the latch. the last reader leaving a closed row promotes waiters.
+void Row_bamboo::drop_fast_reader(uint64_t bit) {
+    uint64_t local = ATOM_FETCH_AND(fast_readers, ~bit);
+    if ((local & BB_FAST_CLOSED) && ((local & ~BB_FAST_CLOSED) == bit)) {
+        if (!owners)
+            bring_next(NULL);
+        reopen_fast_path();
+    }
+}
+
+// fast readers are treated as retired readers ahead of the list: assign them
+// timestamps before the requesting writer so that they keep priority. the
+// caller holds the latch of a closed row, so every bit belongs to the txn
+// its thread is running.
+void Row_bamboo::assign_fast_readers_ts(uint64_t readers) {
+    for (UInt32 tid = 0; tid < g_thread_cnt; tid++) {
+        if (readers & (1UL << tid))
+            assign_ts(0, glob_manager->get_txn_man(tid));
+    }
+}
+
+// wound fast readers with lower priority. the requester dropped its own bit
+// before closing the row.
+void Row_bamboo::wound_fast_readers(ts_t ts, BBLockEntry * to_insert,
+                                    uint64_t readers) {
+    for (UInt32 tid = 0; tid < g_thread_cnt; tid++) {
+        if (!(readers & (1UL << tid)))
+            continue;
+        txn_man * reader = glob_manager->get_txn_man(tid);
+        assert(reader != to_insert->txn);
+        ts_t reader_ts = reader->get_ts();
+        if (reader_ts == 0 || a_higher_than_b(ts, reader_ts))
+            to_insert->txn->wound_txn(reader);
+    }
+}
+#endif
+
+#if BB_RO_FASTPATH
+// must hold the latch. a write becomes part of the committed image when its
+// txn commits, before it is released, so that a read-only txn never sees
+// only part of a committed txn. committed writes are a prefix of the writes
+// in the lists. base is set to the first uncommitted retired write, whose
+// orig_data is the committed image; if there is none the image is the row
+// plus a committed owner's changes.
+uint64_t Row_bamboo::committed_ver(BBLockEntry *& base) {
+    uint64_t ver = commit_cnt;
+    base = NULL;
+    for (BBLockEntry * en = FIRST_RETIRED_WR; en; en = NEXT_RETIRED_WR(en)) {
+        if (en->type != LOCK_EX)
+            continue;
+        if ((en->txn->commit_barriers & 3UL) != COMMITED) {
+            base = en;
+            return ver;
+        }
+        ver++;
+    }
+    if (owners && (owners->txn->commit_barriers & 3UL) == COMMITED)
+        ver++;
+    return ver;
+}
+
+RC Row_bamboo::snapshot_read(txn_man * txn, Access * access) {
+    row_t * data = access->data;
+    data->table = _row->get_table();
+    access->lock_entry->status = LOCK_DROPPED;
+    lock(txn);
+    COMPILER_BARRIER
+    BBLockEntry * base;
+    access->snapshot_ver = committed_ver(base);
+    if (base) {
+#if BB_UNDO_LOG
+        read_before(data, base);
+#else
+        copy_data(data, base->access->orig_data);
+#endif
+    } else {
+        copy_data(data, _row);
+        if (owners && (owners->txn->commit_barriers & 3UL) == COMMITED)
+            copy_data(data, owners->access->data,
+                      owners->access->dirty_fields);
+    }
+    COMPILER_BARRIER
+    unlock(txn);
+    return FINISH;
+}
+
+bool Row_bamboo::snapshot_valid(txn_man * txn, Access * access) {
+    lock(txn);
+    COMPILER_BARRIER
+    BBLockEntry * base;
+    bool valid = (committed_ver(base) == access->snapshot_ver);
+    COMPILER_BARRIER
+    unlock(txn);
+    return valid;
+}
+#endif
+
+#if BB_WAITER_BENCH > 0
+void Row_bamboo::bench_waiters(BBLockEntry ** entries, uint32_t cnt,
+                               uint64_t &insert_time, uint64_t &remove_time) {
+    uint64_t starttime = get_sys_clock();
+    for (uint32_t i = 0; i < cnt; i++)
+        add_to_waiters(entries[i]->txn->get_ts(), entries[i]);
+    uint64_t midtime = get_sys_clock();
+    while (waiters_head)
+        rm_from_waiters(waiters_head);
+    uint64_t endtime = get_sys_clock();
+    insert_time += midtime - starttime;
+    remove_time += endtime - midtime;
+}
+#endif
+
 #if DEBUG_BAMBOO
 void Row_bamboo::check_correctness() {
     // go through retired list and make sure
@@ -753,6 +1144,23 @@ void Row_bamboo::check_correctness() {
 		cnt++;
 		en = en->next;
 	}
+#if BB_RETIRED_WR_INDEX
+	// the write index visits the retired writes in list order
+	en = retired_head;
+	BBLockEntry * wr = retired_wr_head;
+	while (en) {
+		if (en->type == LOCK_EX) {
+			assert(en == wr);
+			wr = wr->next_wr;
+		}
+		en = en->next;
+	}
+	assert(wr == NULL);
+#endif
+#if COMMUTATIVE_OPS
+	if (com_owners)
+		assert(!owners && !retired_head);
+#endif
 	// check owner
 	if (owners) {
 		assert(owners->status == LOCK_OWNER);
@@ -761,6 +1169,11 @@ void Row_bamboo::check_correctness() {
 		largest_ts = owners->txn->get_ts();
 	}
 	// check waiter
+#if BB_WAITER_HEAP
+	if (waiters_head)
+		assert(waiters_head->prev == NULL && waiters_head->next == NULL);
+	assert(check_heap(waiters_head, 0) == waiter_cnt);
+#else
 	cnt = 0;
 	en = waiters_head;
 	while (en) {
@@ -773,5 +1186,22 @@ void Row_bamboo::check_correctness() {
 		cnt++;
 	}
 	assert(cnt == waiter_cnt);
+#endif
 }
+
+#if BB_WAITER_HEAP
+// return the number of waiters in the subtree, checking heap order
+UInt32 Row_bamboo::check_heap(BBLockEntry * en, ts_t min_ts) {
+	UInt32 cnt = 0;
+	while (en) {
+		assert(en->status == LOCK_WAITER);
+		assert(!en->is_cohead);
+		assert(!a_higher_than_b(en->txn->get_ts(), min_ts));
+		cnt += 1 + check_heap(en->child, en->txn->get_ts());
+		en = en->next;
+	}
+	return cnt;
+}
+#endif
 #endif
+#endif // BAMBOO
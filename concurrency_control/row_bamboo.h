@@ -23,6 +23,7 @@
 //         //record time saved from elr is 0.
 //     		
 #define UPDATE_RETIRE_INFO(en, prev) { \
+  UPDATE_DEP_DEPTH(en, prev); \
   if (prev) { \
     if (en->type == LOCK_EX) \
       en->txn->increment_commit_barriers(); \
@@ -39,14 +40,58 @@
     en->is_cohead = true; \
    } }
 
+// a txn joining behind prev depends on the closest write before it and
+// transitively on everything that write depends on
+#if BB_MAX_DEPTH > 0
+#define UPDATE_DEP_DEPTH(en, prev) { \
+  BBLockEntry * dep = Row_bamboo::prev_write(prev); \
+  if (dep && (dep->txn->dep_depth + 1 > en->txn->dep_depth)) \
+    en->txn->dep_depth = dep->txn->dep_depth + 1; }
+#else
+#define UPDATE_DEP_DEPTH(en, prev) {}
+#endif
+
 // used by lock_retire() (move from owners to retired)
 // or by lock_get()/bring_next(), used when has no owners but directly enters retired
 // for the latter need to call UPDATE_RETIRE_INFO(to_insert, retired_tail);
 #define ADD_TO_RETIRED_TAIL(to_retire) { \
   LIST_PUT_TAIL(retired_head, retired_tail, to_retire); \
+  WR_INDEX_PUT_TAIL(to_retire); \
   to_retire->status = LOCK_RETIRED; \
   retired_cnt++; }
 
+// retired writes in list order, linked through next_wr/prev_wr.
+// only appended at the retired tail, since reads are the only entries
+// inserted in the middle of the retired list.
+#if BB_RETIRED_WR_INDEX
+#define WR_INDEX_PUT_TAIL(en) { \
+  if (en->type == LOCK_EX) { \
+    en->next_wr = NULL; \
+    en->prev_wr = retired_wr_tail; \
+    if (retired_wr_tail) retired_wr_tail->next_wr = en; \
+    else retired_wr_head = en; \
+    retired_wr_tail = en; } }
+#define WR_INDEX_RM(en) { \
+  if (en->type == LOCK_EX) { \
+    if (en->next_wr) en->next_wr->prev_wr = en->prev_wr; \
+    else retired_wr_tail = en->prev_wr; \
+    if (en->prev_wr) en->prev_wr->next_wr = en->next_wr; \
+    else retired_wr_head = en->next_wr; } }
+// en (a write) and every entry after it leave the retired list
+#define WR_INDEX_RM_SINCE(en) { \
+  retired_wr_tail = en->prev_wr; \
+  if (retired_wr_tail) retired_wr_tail->next_wr = NULL; \
+  else retired_wr_head = NULL; }
+#define FIRST_RETIRED_WR retired_wr_head
+#define NEXT_RETIRED_WR(en) (en->next_wr)
+#else
+#define WR_INDEX_PUT_TAIL(en) {}
+#define WR_INDEX_RM(en) {}
+#define WR_INDEX_RM_SINCE(en) {}
+#define FIRST_RETIRED_WR retired_head
+#define NEXT_RETIRED_WR(en) (en->next)
+#endif
+
 // Insert to_insert(RD) into the tail when owners is not empty
 // (1) update inserted entry's cohead information
 // (2) NEED to update owners cohead information 
@@ -59,6 +104,7 @@
     owners->txn->increment_commit_barriers(); \
   } \
   LIST_PUT_TAIL(retired_head, retired_tail, to_insert); \
+  WR_INDEX_PUT_TAIL(to_insert); \
   to_insert->status = LOCK_RETIRED; \
   retired_cnt++; }
 
@@ -69,9 +115,25 @@
   to_retire->prev=NULL; \
   ADD_TO_RETIRED_TAIL(to_retire); }
 
+// restore the columns dirtied by en and by the writes retired after it,
+// which are aborted together with en
+#if BB_UNDO_LOG
 #define CHECK_ROLL_BACK(en) { \
-    en->access->orig_row->copy(en->access->orig_data); \
+    undo_writes(en->access->orig_row, en); \
 }
+#else
+#define CHECK_ROLL_BACK(en) { \
+    uint64_t dirty_fields = 0; \
+    for (BBLockEntry * d = en; d != NULL; d = d->next) { \
+        if (d->type == LOCK_EX) \
+            dirty_fields |= d->access->dirty_fields; \
+    } \
+    copy_data(en->access->orig_row, en->access->orig_data, dirty_fields); \
+}
+#endif
+
+// bit of a column in Access::dirty_fields, columns beyond 64 dirty all
+#define BB_DIRTY_BIT(fid) ((fid) < 64 ? (1UL << (fid)) : ~0UL)
 
 #define DEC_BARRIER_PF(entry) { \
     assert(!entry->is_cohead); \
@@ -88,6 +150,35 @@
     entry->txn->decrement_commit_barriers(); \
 }
 
+#if LATCH == LH_LOCKFREE
+#if THREAD_CNT > 63
+#error "LH_LOCKFREE keeps one reader bit per thread in a 64-bit word"
+#endif
+// set once a conflicting request enters the latched path; no new readers may
+// take the fast path until the row is empty again.
+#define BB_FAST_CLOSED (1UL << 63)
+#endif
+
+#if COMMUTATIVE_OPS && LATCH == LH_LOCKFREE
+#error "readers on the LH_LOCKFREE fast path do not see increment-only holders"
+#endif
+
+#if BB_ADAPTIVE_RETIRE
+// contention scores are moving averages in fixed point with 4 fraction bits,
+// each sample weighs 1/8.
+#define BB_SCORE_SHIFT 4
+#define BB_UPDATE_SCORE(score, sample) { \
+  score = score - (score >> 3) + (((uint64_t) (sample) << BB_SCORE_SHIFT) >> 3); }
+#endif
+
+#if CORO_PER_THREAD > 1
+// BBLockEntry::wound_mark, whether a retired write is counted in its row's
+// wounded_wr_cnt. an entry that left the lists can no longer be counted.
+#define BB_WOUND_NONE 		0
+#define BB_WOUND_COUNTED 	1
+#define BB_WOUND_GONE 		2
+#endif
+
 struct BBLockEntry {
     // type of lock: EX or SH
     txn_man * txn;
@@ -100,34 +191,131 @@ struct BBLockEntry {
     bool is_cohead;
     lock_status status;
     BBLockEntry * prev;
+#if BB_WAITER_HEAP
+    // waiters heap: next/prev link siblings, prev of a first child is its
+    // parent
+    BBLockEntry * child;
+#endif
+#if BB_RETIRED_WR_INDEX
+    // neighbouring writes in the retired list
+    BBLockEntry * next_wr;
+    BBLockEntry * prev_wr;
+#endif
+#if CORO_PER_THREAD > 1
+    uint32_t volatile wound_mark;
+#endif
     BBLockEntry(txn_man * t, Access * a): txn(t), access(a), type(LOCK_NONE),
                                           next(NULL), is_cohead(false),
                                           status(LOCK_DROPPED),
-                                          prev(NULL) {};
+                                          prev(NULL) {
+#if BB_WAITER_HEAP
+        child = NULL;
+#endif
+#if CORO_PER_THREAD > 1
+        wound_mark = BB_WOUND_NONE;
+#endif
+    };
 };
 
 class Row_bamboo {
   public:
-    void init(row_t * row);
+    void init(row_t * row, int fid = -1);
+    // frees what init() allocated, before the row is reclaimed
+    void destroy() { delete latch; }
     RC lock_get(lock_t type, txn_man * txn, Access * access);
     RC lock_release(BBLockEntry * entry, RC rc);
     RC lock_retire(BBLockEntry * entry);
+#if BB_RO_FASTPATH
+    // copy the last committed image into access->data, returns FINISH
+    RC snapshot_read(txn_man * txn, Access * access);
+    bool snapshot_valid(txn_man * txn, Access * access);
+#endif
+#if BB_ADAPTIVE_RETIRE
+    // read without the latch, a stale score only delays the switch
+    bool should_retire() {
+        if (cascade_score > (uint64_t) (BB_RETIRE_CASCADE * (1 << BB_SCORE_SHIFT)))
+            return false;
+        return conflict_score >= (uint64_t) (BB_RETIRE_HOT * (1 << BB_SCORE_SHIFT));
+    };
+#endif
+
+#if BB_WAITER_BENCH > 0
+    // queues the entries as waiters in array order, then takes them out in
+    // ts order as bring_next() does. adds up the time of both phases
+    void bench_waiters(BBLockEntry ** entries, uint32_t cnt,
+                       uint64_t &insert_time, uint64_t &remove_time);
+#endif
+
+#if CORO_PER_THREAD > 1
+    // count en, a retired write, as wounded. called by whoever wounds its
+    // txn, without the latch.
+    void wound_retired(BBLockEntry * en) {
+        if (ATOM_CAS(en->wound_mark, BB_WOUND_NONE, BB_WOUND_COUNTED))
+            ATOM_ADD(wounded_wr_cnt, 1);
+    };
+#endif
+
+#if BB_MAX_DEPTH > 0
+    // closest write at or before en in the retired list
+    static BBLockEntry * prev_write(BBLockEntry * en) {
+        while (en && en->type != LOCK_EX)
+            en = en->prev;
+        return en;
+    };
+#endif
 
   private:
     // data structure
     BBLockEntry * owners;
     BBLockEntry * retired_head;
     BBLockEntry * retired_tail;
+#if BB_RETIRED_WR_INDEX
+    BBLockEntry * retired_wr_head;
+    BBLockEntry * retired_wr_tail;
+#endif
+    // with BB_WAITER_HEAP, waiters_head is the heap root and waiters_tail
+    // is unused
     BBLockEntry * waiters_head;
     BBLockEntry * waiters_tail;
     row_t * _row;
+#if BB_FIELD_LOCKING
+    // column guarded by this manager, -1 if it guards the whole tuple
+    int _fid;
+#endif
     UInt32 waiter_cnt;
     UInt32 retired_cnt;
+#if COMMUTATIVE_OPS
+    // LOCK_COM holders, linked by next. they never retire and only hold the
+    // row while owners and retired are empty.
+    BBLockEntry * com_owners;
+#endif
+#if BB_RO_FASTPATH
+    // committed writes released from the lists
+    uint64_t commit_cnt;
+#endif
+#if CORO_PER_THREAD > 1
+    // retired writes of wounded txns. they leave the lists only once their
+    // coroutines run again, and whoever joins behind them before that is
+    // cascaded. may dip below 0 while wound_retired() races a release.
+    int64_t volatile wounded_wr_cnt;
+#endif
+#if BB_ADAPTIVE_RETIRE
+    // entries ahead of a request when it arrives
+    uint64_t conflict_score;
+    // cascading aborts caused by rolling back a retired write
+    uint64_t cascade_score;
+#endif
     // latches
 #if LATCH == LH_SPINLOCK
     pthread_spinlock_t * latch;
 #elif LATCH == LH_MUTEX
     pthread_mutex_t * latch;
+#elif LATCH == LH_LOCKFREE
+    pthread_spinlock_t * latch;
+    // bit i: thread i holds a shared lock taken without the latch.
+    // BB_FAST_CLOSED: the lists are in use, every request takes the latch,
+    // as on LH_SPINLOCK.
+    uint64_t volatile fast_readers;
 #else
     mcslock * latch;
 #endif
@@ -141,8 +329,33 @@ class Row_bamboo {
     void              lock(txn_man * txn);
     void              unlock(txn_man * txn);
 	RC                insert_read_to_retired(BBLockEntry * to_insert, ts_t ts, Access * access);
+#if COMMUTATIVE_OPS
+    RC                com_lock_get(BBLockEntry * to_insert, txn_man * txn);
+    void              rm_from_com_owners(BBLockEntry * entry);
+#endif
+#if BB_RO_FASTPATH
+    uint64_t          committed_ver(BBLockEntry *& base);
+#endif
+#if LATCH == LH_LOCKFREE
+    bool              fast_read_get(txn_man * txn);
+    void              fast_read_release(BBLockEntry * entry);
+    void              drop_fast_reader(uint64_t bit);
+    void              wound_fast_readers(ts_t ts, BBLockEntry * to_insert, uint64_t readers);
+    void              assign_fast_readers_ts(uint64_t readers);
+    // must hold the latch. re-open the fast path if nothing conflicts.
+    void              reopen_fast_path() {
+        if (!owners && !retired_head && !waiters_head)
+            ATOM_FETCH_AND(fast_readers, ~BB_FAST_CLOSED);
+    };
+    bool              has_fast_readers() {
+        return (fast_readers & ~BB_FAST_CLOSED) != 0;
+    };
+#endif
 #if DEBUG_BAMBOO
 	void              check_correctness();
+#if BB_WAITER_HEAP
+	UInt32            check_heap(BBLockEntry * en, ts_t min_ts);
+#endif
 #endif
 
     // check priorities
@@ -150,6 +363,33 @@ class Row_bamboo {
         return a < b;
     };
 
+#if BB_MAX_DEPTH > 0
+    // true if txn joining behind prev would exceed the dependency depth. txn
+    // only waits behind a write of higher priority; as commit dependencies
+    // on lower-priority readers can still close a cycle, such waits time out
+    // in row_t::get_row().
+    inline bool too_deep(BBLockEntry * prev, txn_man * txn) {
+        BBLockEntry * dep = prev_write(prev);
+        if (!dep || dep->txn->dep_depth < BB_MAX_DEPTH)
+            return false;
+        ts_t dep_ts = dep->txn->get_ts();
+        if (dep_ts == 0 || !a_higher_than_b(dep_ts, txn->get_ts()))
+            return false;
+        INC_STATS(txn->get_thd_id(), depth_wait_cnt, 1);
+        return true;
+    };
+#endif
+
+#if CORO_PER_THREAD > 1
+    // a write retired by a txn that is already wounded counts itself, as
+    // the txn's wounder may have looked at the entry before it retired
+    inline void count_if_wounded(BBLockEntry * en) {
+        __sync_synchronize();
+        if (en->type == LOCK_EX && (en->txn->commit_barriers & 3UL) == ABORTED)
+            wound_retired(en);
+    };
+#endif
+
     inline static int assign_ts(ts_t ts, txn_man * txn) {
         if (ts == 0) {
             ts = txn->set_next_ts(1);
@@ -171,6 +411,12 @@ class Row_bamboo {
         entry->prev = NULL;
         entry->status = LOCK_DROPPED;
         entry->is_cohead = false;
+#if BB_WAITER_HEAP
+        entry->child = NULL;
+#endif
+#if CORO_PER_THREAD > 1
+        entry->wound_mark = BB_WOUND_NONE;
+#endif
         return entry;
     #else
         return NULL;
@@ -178,23 +424,164 @@ class Row_bamboo {
     };
 
 
+    // copy the columns in fields that are guarded by this manager
+    inline void copy_data(row_t * dst, row_t * src, uint64_t fields = ~0UL) {
+#if BB_FIELD_LOCKING
+        if (_fid >= 0) {
+            dst->copy(src, _fid);
+            return;
+        }
+#endif
+        if (fields == ~0UL) {
+            dst->copy(src);
+            return;
+        }
+        while (fields) {
+            dst->copy(src, __builtin_ctzl(fields));
+            fields &= fields - 1;
+        }
+    };
+
+#if BB_UNDO_LOG
+    // apply the before-images logged by the retired writes from the tail
+    // back to en (inclusive) to dst, newest first. a column manager only
+    // restores its own column, the others belong to other managers' txns.
+    inline void undo_writes(row_t * dst, BBLockEntry * en) {
+        for (BBLockEntry * d = retired_tail; d; d = d->prev) {
+            if (d->type == LOCK_EX) {
+                for (UndoRec * rec = d->access->undo; rec; rec = rec->prev) {
+#if BB_FIELD_LOCKING
+                    if (_fid >= 0 && rec->fid != _fid)
+                        continue;
+#endif
+                    dst->set_value_plain(rec->fid, (char *) (rec + 1));
+                }
+            }
+            if (d == en)
+                break;
+        }
+    };
+
+    // image of the row before retired write en
+    inline void read_before(row_t * dst, BBLockEntry * en) {
+        copy_data(dst, _row);
+        undo_writes(dst, en);
+    };
+#endif
+
     // clean the lock entry
     void return_entry(BBLockEntry * entry) {
         entry->next = NULL;
         entry->prev = NULL;
         entry->status = LOCK_DROPPED;
+#if CORO_PER_THREAD > 1
+        if (ATOM_SWAP(entry->wound_mark, BB_WOUND_GONE) == BB_WOUND_COUNTED)
+            ATOM_SUB(wounded_wr_cnt, 1);
+#endif
     };
 
-	inline bool bring_out_waiter(BBLockEntry * entry, txn_man * txn) {
+#if BB_WAITER_HEAP
+	// pairing heap on ts. a and b are roots, the one with lower priority
+	// becomes the first child of the other.
+	inline static BBLockEntry * heap_meld(BBLockEntry * a, BBLockEntry * b) {
+		if (a_higher_than_b(b->txn->get_ts(), a->txn->get_ts())) {
+			BBLockEntry * tmp = a;
+			a = b;
+			b = tmp;
+		}
+		b->prev = a;
+		b->next = a->child;
+		if (a->child)
+			a->child->prev = b;
+		a->child = b;
+		return a;
+	};
+
+	// meld a list of siblings into one heap: pair them left to right, then
+	// meld the pairs right to left.
+	inline static BBLockEntry * heap_merge_pairs(BBLockEntry * first) {
+		if (!first)
+			return NULL;
+		BBLockEntry * pairs = NULL; // stack of melded pairs, linked by next
+		while (first) {
+			BBLockEntry * a = first;
+			BBLockEntry * b = a->next;
+			a->prev = NULL;
+			if (!b) {
+				a->next = pairs;
+				pairs = a;
+				break;
+			}
+			first = b->next;
+			b->next = NULL;
+			b->prev = NULL;
+			a = heap_meld(a, b);
+			a->next = pairs;
+			pairs = a;
+		}
+		BBLockEntry * root = pairs;
+		pairs = pairs->next;
+		root->next = NULL;
+		while (pairs) {
+			BBLockEntry * en = pairs;
+			pairs = pairs->next;
+			en->next = NULL;
+			root = heap_meld(root, en);
+		}
+		return root;
+	};
+#endif
+
+	inline void rm_from_waiters(BBLockEntry * entry) {
+#if BB_WAITER_HEAP
+		if (entry == waiters_head) {
+			waiters_head = heap_merge_pairs(entry->child);
+		} else {
+			// unlink from siblings and parent, then meld its children back
+			if (entry->prev->child == entry)
+				entry->prev->child = entry->next;
+			else
+				entry->prev->next = entry->next;
+			if (entry->next)
+				entry->next->prev = entry->prev;
+			BBLockEntry * sub = heap_merge_pairs(entry->child);
+			if (sub)
+				waiters_head = heap_meld(waiters_head, sub);
+		}
+		entry->next = NULL;
+		entry->prev = NULL;
+		entry->child = NULL;
+		waiter_cnt--;
+#else
 		LIST_RM(waiters_head, waiters_tail, entry, waiter_cnt);
+#endif
+	};
+
+	inline bool bring_out_waiter(BBLockEntry * entry, txn_man * txn) {
+		rm_from_waiters(entry);
 		entry->txn->lock_ready = true;
 		if (txn == entry->txn) {
 			return true;
 		}
+#if CC_ALG == BAMBOO && BB_SPIN_PARK
+		entry->txn->wakeup();
+#endif
 		return false;
 	};
 
 	inline void add_to_waiters(ts_t ts, BBLockEntry * to_insert) {
+#if PF_CS
+		INC_STATS(to_insert->txn->get_thd_id(), waiter_len, waiter_cnt);
+#endif
+#if BB_WAITER_HEAP
+		to_insert->next = NULL;
+		to_insert->prev = NULL;
+		to_insert->child = NULL;
+		if (waiters_head)
+			waiters_head = heap_meld(waiters_head, to_insert);
+		else
+			waiters_head = to_insert;
+#else
 		BBLockEntry * en = waiters_head;
 		while (en != NULL) {
 			if (ts < en->txn->get_ts())
@@ -208,6 +595,7 @@ class Row_bamboo {
 		} else {
 			LIST_PUT_TAIL(waiters_head, waiters_tail, to_insert);
 		}
+#endif
 		to_insert->status = LOCK_WAITER;
 		to_insert->txn->lock_ready = false;
 		waiter_cnt++;
@@ -218,18 +606,20 @@ class Row_bamboo {
 	// dynamically assigned ts. e.g. [0,0,0] -> [12, 11, 5]
 	// used when to_insert->type = LOCK_SH
 	inline RC wound_retired_rd(ts_t ts, BBLockEntry * to_insert) {
-		BBLockEntry * en = retired_head;
+		BBLockEntry * en = FIRST_RETIRED_WR;
 		while(en) {
 			if (en->type == LOCK_EX && a_higher_than_b(ts, en->txn->get_ts())) {
 				if (to_insert->txn->wound_txn(en->txn) == COMMITED) {
 					//return_entry(to_insert);
 					//return Abort;
-                    en = en->next;
+                    en = NEXT_RETIRED_WR(en);
                     continue;
 				}
-				en = rm_from_retired(en, true, to_insert->txn);
+				// aborts every entry after en as well
+				rm_from_retired(en, true, to_insert->txn);
+				break;
 			} else 
-				en = en->next;
+				en = NEXT_RETIRED_WR(en);
 		}
 		return RCOK;
 	};
@@ -41,7 +41,8 @@ Row_hekaton::doubleHistory()
 
 	_his_oldest = 0;
 	_his_latest = _his_len - 1; 
-	_mm_free(_write_history);
+	// readers may still walk the old history
+	glob_manager->retire(_write_history, _mm_free);
 	_write_history = temp;
 
 	_his_len *= 2;
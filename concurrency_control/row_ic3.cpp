@@ -15,7 +15,7 @@ Cell_ic3::init(row_t * orig_row, uint64_t id) {
   acclist_cnt = 0;
   lock = 0;
   /*
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
   latch = new pthread_spinlock_t;
   pthread_spin_init(latch, PTHREAD_PROCESS_SHARED);
 #elif LATCH == LH_MUTEX
@@ -47,7 +47,7 @@ bool
 Cell_ic3::try_lock() {
 /*
 #if THREAD_CNT > 1
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
   pthread_spin_lock( latch );
 #elif LATCH == LH_MUTEX
   pthread_mutex_lock( latch );
@@ -67,7 +67,7 @@ void
 Cell_ic3::release() {
 	/*
 #if THREAD_CNT > 1
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
   pthread_spin_unlock( latch );
 #elif LATCH == LH_MUTEX
   pthread_mutex_unlock( latch );
@@ -136,7 +136,7 @@ Cell_ic3::rm_from_acclist(txn_man * txn, bool aborted) {
   if (to_rm) {
     LIST_REMOVE_HT(to_rm, acclist, acclist_tail);
     acclist_cnt--;
-    free(to_rm);
+    mem_allocator.free(to_rm, sizeof(IC3LockEntry));
   }
   release();
 }
@@ -224,7 +224,7 @@ Row_ic3::rm_from_acclist(txn_man * txn, bool aborted) {
   if (to_rm) {
     LIST_REMOVE_HT(to_rm, acclist, acclist_tail);
     acclist_cnt--;
-    free(to_rm);
+    mem_allocator.free(to_rm, sizeof(IC3LockEntry));
   }
   release();
 }
@@ -40,7 +40,7 @@ class Cell_ic3 {
   IC3LockEntry *        acclist_tail;
   volatile int          lock;
   /*
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
   pthread_spinlock_t *  latch;
 #elif LATCH == LH_MUTEX
   pthread_mutex_t *     latch;
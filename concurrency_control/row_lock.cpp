@@ -12,7 +12,7 @@ void Row_lock::init(row_t * row) {
   owner_cnt = 0;
   waiter_cnt = 0;
 
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
   latch = new pthread_spinlock_t;
 	pthread_spin_init(latch, PTHREAD_PROCESS_SHARED);
 #elif LATCH == LH_MUTEX
@@ -32,7 +32,7 @@ void Row_lock::lock(txn_man * txn) {
             if (unlikely(g_central_man))
                 glob_manager->lock_row(_row);
             else {
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
                 pthread_spin_lock( latch );
 #elif LATCH == LH_MUTEX
                 pthread_mutex_lock( latch );
@@ -49,7 +49,7 @@ void Row_lock::unlock(txn_man * txn) {
             if (unlikely(g_central_man))
                 glob_manager->release_row(_row);
             else {
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
                 pthread_spin_unlock( latch );
 #elif LATCH == LH_MUTEX
                 pthread_mutex_unlock( latch );
@@ -15,6 +15,8 @@ struct LockEntry {
 class Row_lock {
   public:
     void init(row_t * row);
+    // frees what init() allocated, before the row is reclaimed
+    void destroy() { delete latch; }
     // [DL_DETECT] txnids are the txn_ids that current txn is waiting for.
     RC lock_get(lock_t type, txn_man * txn, Access * access);
     RC lock_get(lock_t type, txn_man * txn, uint64_t* &txnids, int &txncnt, Access * access);
@@ -23,7 +25,7 @@ class Row_lock {
     void unlock(txn_man * txn);
 
   private:
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
     pthread_spinlock_t * latch;
 #elif LATCH == LH_MUTEX
     pthread_mutex_t * latch;
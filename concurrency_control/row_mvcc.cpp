@@ -74,7 +74,8 @@ Row_mvcc::double_list(uint32_t list)
 			temp[i].reserved = false;
 			temp[i].row = NULL;
 		}
-		_mm_free(_write_history);
+		// readers may still walk the old history
+		glob_manager->retire(_write_history, _mm_free);
 		_write_history = temp;
 		_his_len = _his_len * 2;
 	} else {
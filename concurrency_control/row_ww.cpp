@@ -14,7 +14,7 @@ void Row_ww::init(row_t * row) {
   owner_cnt = 0;
   waiter_cnt = 0;
 
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
   latch = new pthread_spinlock_t;
 	pthread_spin_init(latch, PTHREAD_PROCESS_SHARED);
 #elif LATCH == LH_MUTEX
@@ -34,7 +34,7 @@ void Row_ww::lock(txn_man * txn) {
             if (unlikely(g_central_man))
                 glob_manager->lock_row(_row);
             else {
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
                 pthread_spin_lock( latch );
 #elif LATCH == LH_MUTEX
                 pthread_mutex_lock( latch );
@@ -51,7 +51,7 @@ void Row_ww::unlock(txn_man * txn) {
             if (unlikely(g_central_man))
                 glob_manager->release_row(_row);
             else {
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
                 pthread_spin_unlock( latch );
 #elif LATCH == LH_MUTEX
                 pthread_mutex_unlock( latch );
@@ -91,10 +91,10 @@ RC Row_ww::lock_get(lock_t type, txn_man * txn, uint64_t* &txnids, int&txncnt,
   starttime = endtime;
 #endif
 
-  // each thread has at most one owner of a lock
-  assert(owner_cnt <= g_thread_cnt);
-  // each thread has at most one waiter
-  assert(waiter_cnt < g_thread_cnt);
+  // each txn has at most one owner of a lock
+  assert(owner_cnt <= g_thread_cnt * CORO_PER_THREAD);
+  // each txn has at most one waiter
+  assert(waiter_cnt < g_thread_cnt * CORO_PER_THREAD);
 
   if (owner_cnt == 0) {
     // if owner is empty, grab the lock
@@ -244,8 +244,8 @@ bool Row_ww::conflict_lock(lock_t l1, lock_t l2) {
     return false;
   else if (l1 == LOCK_EX || l2 == LOCK_EX)
     return true;
-  else
-    return false;
+  else // increments share only with increments
+    return l1 != l2;
 }
 
 inline 
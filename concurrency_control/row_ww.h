@@ -6,6 +6,8 @@
 class Row_ww {
  public:
   void init(row_t * row);
+  // frees what init() allocated, before the row is reclaimed
+  void destroy() { delete latch; }
   RC lock_get(lock_t type, txn_man * txn, Access * access);
   RC lock_get(lock_t type, txn_man * txn, uint64_t* &txnids, int &txncnt, Access * access);
   RC lock_release(LockEntry * entry);
@@ -13,7 +15,7 @@ class Row_ww {
   void unlock(txn_man * txn);
 
  private:
-#if LATCH == LH_SPINLOCK
+#if LATCH == LH_SPINLOCK || LATCH == LH_LOCKFREE
   pthread_spinlock_t * latch;
 #elif LATCH == LH_MUTEX
   pthread_mutex_t * latch;
@@ -31,8 +31,24 @@
 #define MEM_PAD 					true
 
 // [PART_ALLOC]
+// binds the rows, lock managers and hash buckets of each partition to a NUMA
+// node and pins every thread to the node of its FIRST_PART_LOCAL partition.
 #define PART_ALLOC 					false
 #define MEM_SIZE					(1UL << 30)
+
+// [HUGE_PAGE]
+// rows, lock managers and hash index nodes created while the tables are
+// loaded are carved from huge-page regions and never freed. HP_THP advises
+// transparent huge pages; HP_2MB/HP_1GB map hugetlbfs pages (reserve them in
+// /sys/kernel/mm/hugepages first) and fall back to HP_THP if none are left.
+#define HUGE_PAGE					HP_NONE
+
+// [EPOCH_RECLAIM]
+// rows, index nodes and version buffers unlinked while txns run are put on
+// per-thread limbo lists and freed once the txns that could hold them are
+// done. the epoch advances every LOG_BATCH_TIME. Off by default, only
+// YCSB_CHURN and aborted inserts give memory back.
+#define EPOCH_RECLAIM				false
 #define NO_FREE						false
 
 /***********************************************/
@@ -44,10 +60,19 @@
 #define ISOLATION_LEVEL 			SERIALIZABLE
 
 // latch options
+// LH_LOCKFREE: Row_bamboo admits readers of an uncontended row through a CAS
+// on a per-row reader bitmap (requires THREAD_CNT < 64). Once a writer shows
+// up, every lock request, retire and release takes the latch until the row's
+// lists are empty again. Other row managers treat it as LH_SPINLOCK.
 #define LATCH					    LH_SPINLOCK
 
 // all transactions acquire tuples according to the primary key order.
 #define KEY_ORDER					false
+// txns each worker thread interleaves (WOUND_WAIT, BAMBOO). Above 1, every
+// txn runs on its own stack and yields to the next one of the same thread
+// at lock waits and commit-barrier waits instead of spinning.
+#define CORO_PER_THREAD				1
+#define CORO_STACK_SIZE				(1UL << 20)
 // transaction roll back changes after abort
 #define ROLL_BACK					true
 // per-row lock/ts management or central lock/ts management
@@ -61,7 +86,15 @@
 #define CENTRAL_INDEX				false
 #define CENTRAL_MANAGER 			false
 #define INDEX_STRUCT				IDX_HASH
-#define BTREE_ORDER 				16
+// [IDX_HASH] average keys per bucket before a partition doubles its buckets
+#define HASH_LOAD_FACTOR			2
+// [IDX_BTREE] children per node. Keys and pointers are inline, so a node
+// takes 16 * BTREE_ORDER + 16 bytes (64 -> 1KB)
+#define BTREE_ORDER 				64
+// NewOrder and YCSB resolve all their index probes with one
+// index_read_batch(), which keeps IDX_BATCH_GROUP lookups in flight
+#define IDX_BATCH 					false
+#define IDX_BATCH_GROUP 			8
 
 // [DL_DETECT]
 #define DL_LOOP_DETECT				1000 	// 100 us
@@ -104,8 +137,48 @@
 #define BB_OPT_RAW                  true
 #define BB_LAST_RETIRE                 0
 #define BB_PRECOMMIT                false
+// retire a write when the txn requests its next row instead of at the
+// retire_row() calls placed in the workloads
 #define BB_AUTORETIRE               false
 #define BB_ALWAYS_RETIRE_READ       true
+// lock warehouse and district tuples per column, so that writers of disjoint
+// columns (e.g. W_YTD and W_TAX) never queue behind each other
+#define BB_FIELD_LOCKING            false
+// decide per row at runtime whether a write retires early: rows that see
+// on average BB_RETIRE_HOT conflicting entries per request retire, rows whose
+// retired writes cascade more than BB_RETIRE_CASCADE aborts on average hold
+// the lock until commit as in wound-wait. Replaces BB_LAST_RETIRE in YCSB.
+#define BB_ADAPTIVE_RETIRE          false
+#define BB_RETIRE_HOT               0.5
+#define BB_RETIRE_CASCADE           1
+// max length of the chain of uncommitted writes a txn may depend on by
+// reading dirty data; deeper requests wait instead, for at most TIMEOUT.
+// 0 means unbounded.
+#define BB_MAX_DEPTH                0
+// wait for commit barriers and lock grants by spinning BB_SPIN_CNT rounds,
+// then parking on a futex. for THREAD_CNT above the core count.
+#define BB_SPIN_PARK                false
+#define BB_SPIN_CNT                 1000
+// keep waiters in a pairing heap ordered by ts instead of a sorted list:
+// O(log n) amortized insert instead of a walk under the latch.
+#define BB_WAITER_HEAP              false
+// > 0: skip the workload and time BB_WAITER_BENCH txns joining the waiters
+// of one row in random ts order and being granted in ts order,
+// BB_WAITER_BENCH_ROUNDS times. prints ns per insert and per removal.
+#define BB_WAITER_BENCH             0
+#define BB_WAITER_BENCH_ROUNDS      1000
+// chain retired writes together so readers looking for the first
+// lower-priority write skip the retired reads
+#define BB_RETIRED_WR_INDEX         false
+// read-only txns copy the last committed image of each row without joining
+// its lists, and validate the copies at commit
+#define BB_RO_FASTPATH              false
+// log before-images of the columns written through set_value() instead of
+// copying the whole tuple for rollback on every write
+#define BB_UNDO_LOG                 false
+// tuple buffers of a txn are carved from chunks of BB_ROW_BUF_CHUNK bytes,
+// more chunks are chained when a txn outgrows them
+#define BB_ROW_BUF_CHUNK            (1UL << 16)
 // [WW]
 #define WW_STARV_FREE               false // set false if compared w/ bamboo
 // [IC3]
@@ -148,6 +221,15 @@
 #define LONG_TXN_RATIO			        0
 #define LONG_TXN_READ_RATIO			0.5
 #define FIELD_PER_TUPLE				10
+// resolve the index item and prefetch the row of the request this many
+// requests ahead (its hash bucket twice as far ahead). 0 disables.
+#define YCSB_PREFETCH_DIST			0
+// after each committed txn, insert a row under a new key and delete the one
+// inserted YCSB_CHURN_DEPTH txns earlier. The keys are above
+// SYNTH_TABLE_SIZE, so no request reads them, but they exercise
+// index_remove(), table_t::delete_row() and EPOCH_RECLAIM.
+#define YCSB_CHURN					false
+#define YCSB_CHURN_DEPTH			64
 // ==== [YCSB-synthetic] ====
 #define SYNTHETIC_YCSB              true
 #define POS_HS                      TOP
@@ -191,7 +273,8 @@ extern TPCCTxnType 					g_tpcc_txn_type;
 // enable user-initiated aborts in new-order txn according to TPC-C doc.
 #define TPCC_USER_ABORT             true
 
-// Optimizations used in IC3
+// Optimizations used in IC3. under WOUND_WAIT and BAMBOO, increment-only
+// accesses (CM) share the row and add their deltas at commit
 #define COMMUTATIVE_OPS          false
 
 /***********************************************/
@@ -237,6 +320,8 @@ extern TestCases					g_test_case;
 #define PF_CS          					false // profiling inside critical path
 #define PF_ABORT_LENGTH          			false
 #define PF_MODEL          false
+// count last-level cache and dTLB load misses of each worker (perf_event_open)
+#define PF_MISS						false
 
 /***********************************************/
 // Constant
@@ -244,6 +329,7 @@ extern TestCases					g_test_case;
 // INDEX_STRUCT
 #define IDX_HASH 					1
 #define IDX_BTREE					2
+#define IDX_SIMD					3
 // WORKLOAD
 #define YCSB						1
 #define TPCC						2
@@ -252,6 +338,7 @@ extern TestCases					g_test_case;
 #define LH_SPINLOCK                   1
 #define LH_MUTEX                      2
 #define LH_MCSLOCK                    3
+#define LH_LOCKFREE                   4
 // Concurrency Control Algorithm
 #define NO_WAIT						1
 #define WAIT_DIE					2
@@ -283,5 +370,10 @@ extern TestCases					g_test_case;
 #define TM                          4
 #define MB                          5
 #define SPECIFIED                   6
+// Huge pages
+#define HP_NONE						0
+#define HP_THP						1
+#define HP_2MB						2
+#define HP_1GB						3
 
 #endif
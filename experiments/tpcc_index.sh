@@ -0,0 +1,24 @@
+cd ..
+rm outputs/stats.json
+
+# composite TPC-C keys, index time per txn (time_index / txn_cnt) vs. index structure
+for i in 0 1 2
+do
+for wh in 1 16
+do
+for idx in IDX_HASH IDX_SIMD
+do
+		python test.py experiments/tpcc.json NUM_WH=${wh} CC_ALG=BAMBOO INDEX_STRUCT=${idx} OUTPUT_TO_FILE=true CPU_FREQ=2.8
+done
+done
+done
+
+fname="tpcc_index"
+cd outputs/
+python3 collect_stats.py
+mv stats.csv tpcc/${fname}.csv
+mv stats.json tpcc/${fname}.json
+cd ..
+
+cd experiments
+python3 send_email.py ${fname}
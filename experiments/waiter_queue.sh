@@ -0,0 +1,24 @@
+cd ..
+rm outputs/stats.json
+
+# ns per waiter insert and removal on one row (BB_WAITER_BENCH) vs. waiters
+for i in 0 1 2
+do
+for heap in false true
+do
+for n in 2 4 8 16 32 64 128 256 512 1024
+do
+		python test.py experiments/synthetic_ycsb.json THREAD_CNT=1 CC_ALG=BAMBOO BB_WAITER_HEAP=${heap} BB_WAITER_BENCH=${n} OUTPUT_TO_FILE=true CPU_FREQ=2.8
+done
+done
+done
+
+fname="waiter_queue"
+cd outputs/
+python3 collect_stats.py
+mv stats.csv synthetic/${fname}.csv
+mv stats.json synthetic/${fname}.json
+cd ..
+
+cd experiments
+python3 send_email.py ${fname}
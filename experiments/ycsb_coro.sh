@@ -0,0 +1,25 @@
+cd ..
+rm outputs/stats.json
+
+# txns interleaved per worker thread, one worker per core
+thd=32
+for i in 0 1 2
+do
+for coro in 1 2 4 8
+do
+for alg in BAMBOO WOUND_WAIT
+do
+		python test.py experiments/synthetic_ycsb.json THREAD_CNT=${thd} SPECIFIED_RATIO=0 CC_ALG=${alg} CORO_PER_THREAD=${coro} OUTPUT_TO_FILE=true CPU_FREQ=2.8
+done
+done
+done
+
+fname="ycsb_coro"
+cd outputs/
+python3 collect_stats.py
+mv stats.csv synthetic/${fname}.csv
+mv stats.json synthetic/${fname}.json
+cd ..
+
+cd experiments
+python3 send_email.py ${fname}
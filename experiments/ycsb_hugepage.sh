@@ -0,0 +1,26 @@
+cd ..
+rm outputs/stats.json
+
+# 10M-row table, dTLB misses per txn (dtlb_miss_cnt / txn_cnt) vs. page size
+# HP_2MB/HP_1GB need reserved pages, e.g.
+#   echo 12000 > /sys/kernel/mm/hugepages/hugepages-2048kB/nr_hugepages
+for i in 0 1 2
+do
+for hp in HP_NONE HP_THP HP_2MB HP_1GB
+do
+for alg in BAMBOO WOUND_WAIT
+do
+		python test.py experiments/large_dataset.json SYNTH_TABLE_SIZE=10000000 CC_ALG=${alg} HUGE_PAGE=${hp} PF_MISS=true OUTPUT_TO_FILE=true CPU_FREQ=2.8
+done
+done
+done
+
+fname="ycsb_hugepage"
+cd outputs/
+python3 collect_stats.py
+mv stats.csv synthetic/${fname}.csv
+mv stats.json synthetic/${fname}.json
+cd ..
+
+cd experiments
+python3 send_email.py ${fname}
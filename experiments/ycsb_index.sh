@@ -0,0 +1,24 @@
+cd ..
+rm outputs/stats.json
+
+# 10M-row table, index time per txn (time_index / txn_cnt) vs. index structure
+for i in 0 1 2
+do
+for idx in IDX_HASH IDX_SIMD
+do
+for alg in BAMBOO WOUND_WAIT
+do
+		python test.py experiments/large_dataset.json SYNTH_TABLE_SIZE=10000000 CC_ALG=${alg} INDEX_STRUCT=${idx} OUTPUT_TO_FILE=true CPU_FREQ=2.8
+done
+done
+done
+
+fname="ycsb_index"
+cd outputs/
+python3 collect_stats.py
+mv stats.csv synthetic/${fname}.csv
+mv stats.json synthetic/${fname}.json
+cd ..
+
+cd experiments
+python3 send_email.py ${fname}
@@ -0,0 +1,24 @@
+cd ..
+rm outputs/stats.json
+
+# 10M-row table, misses per txn (cache_miss_cnt / txn_cnt) vs. prefetch distance
+for i in 0 1 2
+do
+for dist in 0 1 2 4 8
+do
+for alg in BAMBOO WOUND_WAIT
+do
+		python test.py experiments/large_dataset.json SYNTH_TABLE_SIZE=10000000 CC_ALG=${alg} YCSB_PREFETCH_DIST=${dist} PF_MISS=true OUTPUT_TO_FILE=true CPU_FREQ=2.8
+done
+done
+done
+
+fname="ycsb_prefetch"
+cd outputs/
+python3 collect_stats.py
+mv stats.csv synthetic/${fname}.csv
+mv stats.json synthetic/${fname}.json
+cd ..
+
+cd experiments
+python3 send_email.py ${fname}
@@ -0,0 +1,24 @@
+cd ..
+rm outputs/stats.json
+
+# latch hold time (time_get_cs) vs. waiters per blocked request (waiter_len / wait_cnt)
+for i in 0 1 2
+do
+for heap in false true
+do
+for thd in 8 16 32 64 96 120
+do
+		python test.py experiments/synthetic_ycsb.json THREAD_CNT=${thd} SPECIFIED_RATIO=0 CC_ALG=BAMBOO BB_WAITER_HEAP=${heap} PF_CS=true OUTPUT_TO_FILE=true CPU_FREQ=2.8
+done
+done
+done
+
+fname="ycsb_waiters"
+cd outputs/
+python3 collect_stats.py
+mv stats.csv synthetic/${fname}.csv
+mv stats.json synthetic/${fname}.json
+cd ..
+
+cd experiments
+python3 send_email.py ${fname}
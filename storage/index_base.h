@@ -23,8 +23,18 @@ public:
 							itemid_t * &item,
 							int part_id=-1, int thd_id=0)=0;
 
-	// TODO implement index_remove
-	virtual RC 			index_remove(idx_key_t key) { return RCOK; };
+	// resolves keys[i] of partition part_ids[i] into items[i]. Indexes may
+	// interleave the lookups to overlap their cache misses
+	virtual RC 			index_read_batch(idx_key_t * keys, int * part_ids,
+							uint32_t cnt, itemid_t ** items, int thd_id=0) {
+		for (uint32_t i = 0; i < cnt; i++)
+			index_read(keys[i], items[i], part_ids[i], thd_id);
+		return RCOK;
+	};
+
+	// drops key and its items, ERROR if the key is absent. Lookups may still
+	// hold the items, they are freed through Manager::retire()
+	virtual RC 			index_remove(idx_key_t key, int part_id=-1)=0;
 	
 	// the index in on "table". The key is the merged key of "fields"
 	table_t * 			table;
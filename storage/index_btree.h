@@ -5,36 +5,46 @@
 #include "helper.h"
 #include "index_base.h"
 
+// B+tree with optimistic lock coupling (Leis et al., "The ART of practical
+// synchronization"). Every node carries a version word. Readers remember
+// the version, read the node and check the version again, restarting from
+// the root if a writer got in between, so a lookup writes no shared line.
+// Writers lock only the nodes they change by adding BT_LOCKED (bit 1) to the
+// version and add it again to unlock, so versions stay even and every write
+// leaves a node with a new one.
+// Full nodes are split on the way down. Removal only takes the key out of
+// its leaf, nodes are never merged or freed.
+#define BT_LOCKED 					2UL
 
 typedef struct bt_node {
-	// TODO bad hack!
-   	void ** pointers; // for non-leaf nodes, point to bt_nodes
+	// bit 1 (BT_LOCKED) is set while a writer holds the node, bit 0 is
+	// always clear
+	uint64_t volatile version;
 	bool is_leaf;
-	idx_key_t * keys;
-	bt_node * parent;
 	UInt32 num_keys;
+	// right sibling, leaves only, for index_next()
 	bt_node * next;
-	bool latch;
-	pthread_mutex_t locked;
-	latch_t latch_type;
-	UInt32 share_cnt;
+	// keys and pointers are inline, BTREE_ORDER sets the node size
+	idx_key_t keys[BTREE_ORDER - 1];
+	// for non-leaf nodes, point to bt_nodes. pointers[i] holds the keys
+	// below keys[i], leaves keep the itemid of keys[i] in pointers[i]
+	void * pointers[BTREE_ORDER];
 } bt_node;
 
-struct glob_param {
-	uint64_t part_id;
-};
-
 class index_btree : public index_base {
 public:
 	RC			init(uint64_t part_cnt);
 	RC			init(uint64_t part_cnt, table_t * table);
 	bool 		index_exist(idx_key_t key); // check if the key exist. 
 	RC 			index_insert(idx_key_t key, itemid_t * item, int part_id = -1);
-	RC	 		index_read(idx_key_t key, itemid_t * &item, 
-					uint64_t thd_id, int64_t part_id = -1);
 	RC	 		index_read(idx_key_t key, itemid_t * &item, int part_id = -1);
-	RC	 		index_read(idx_key_t key, itemid_t * &item);
+	// also remembers the position for index_next()
+	RC	 		index_read(idx_key_t key, itemid_t * &item,
+					int part_id = -1, int thd_id = 0);
+	// scans are not validated, like the latch-free tree before
 	RC 			index_next(uint64_t thd_id, itemid_t * &item, bool samekey = false);
+	// the items of key are retired, a leaf left empty stays in the tree
+	RC 			index_remove(idx_key_t key, int part_id = -1);
 
 private:
 	// index structures may have part_cnt = 1 or PART_CNT.
@@ -42,30 +52,34 @@ private:
 	RC			make_lf(uint64_t part_id, bt_node *& node);
 	RC			make_nl(uint64_t part_id, bt_node *& node);
 	RC		 	make_node(uint64_t part_id, bt_node *& node);
-	
-	RC 			start_new_tree(glob_param params, idx_key_t key, itemid_t * item);
-	RC 			find_leaf(glob_param params, idx_key_t key, idx_acc_t access_type, bt_node *& leaf, bt_node  *& last_ex);
-	RC 			find_leaf(glob_param params, idx_key_t key, idx_acc_t access_type, bt_node *& leaf);
-	RC			insert_into_leaf(glob_param params, bt_node * leaf, idx_key_t key, itemid_t * item);
-	// handle split
-	RC 			split_lf_insert(glob_param params, bt_node * leaf, idx_key_t key, itemid_t * item);
-	RC 			split_nl_insert(glob_param params, bt_node * node, UInt32 left_index, idx_key_t key, bt_node * right);
-	RC 			insert_into_parent(glob_param params, bt_node * left, idx_key_t key, bt_node * right);
-	RC 			insert_into_new_root(glob_param params, bt_node * left, idx_key_t key, bt_node * right);
 
-	int			leaf_has_key(bt_node * leaf, idx_key_t key);
-	
+	// returns the leaf that holds key, version is the one it was read at
+	bt_node * 	find_leaf(uint64_t part_id, idx_key_t key, uint64_t &version);
+	// one descent of index_insert, false if it has to restart
+	bool 		try_insert(uint64_t part_id, idx_key_t key, itemid_t * item);
+	// moves the upper half of the locked, full node into a new right node,
+	// sep is the smallest key left to the right one
+	bt_node * 	split(uint64_t part_id, bt_node * node, idx_key_t &sep);
+	// parent is write-locked and not full
+	void 		insert_into_parent(bt_node * parent, idx_key_t sep, bt_node * right);
+	void 		insert_into_new_root(uint64_t part_id, bt_node * left,
+					idx_key_t sep, bt_node * right);
+
+	// first key >= key in leaves, first key > key in inner nodes
+	UInt32 		lower_bound(bt_node * node, idx_key_t key);
+	UInt32 		child_idx(bt_node * node, idx_key_t key);
+
+	// optimistic lock coupling
+	bool 		read_lock(bt_node * node, uint64_t &version);
+	bool 		validate(bt_node * node, uint64_t version);
+	bool 		upgrade_lock(bt_node * node, uint64_t version);
+	void 		write_unlock(bt_node * node);
+
 	UInt32 		cut(UInt32 length);
 	UInt32	 	order; // # of keys in a node(for both leaf and non-leaf)
-	bt_node ** 	roots; // each partition has a different root
+	bt_node * volatile * roots; // each partition has a different root
 	bt_node *   find_root(uint64_t part_id);
 
-	bool 		latch_node(bt_node * node, latch_t latch_type);
-	latch_t		release_latch(bt_node * node);
-	RC		 	upgrade_latch(bt_node * node);
-	// clean up all the LATCH_EX up tp last_ex
-	RC 			cleanup(bt_node * node, bt_node * last_ex);
-
 	// the leaf and the idx within the leaf that the thread last accessed.
 	bt_node *** cur_leaf_per_thd;
 	UInt32 ** 		cur_idx_per_thd;
@@ -2,15 +2,40 @@
 #include "index_hash.h"
 #include "mem_alloc.h"
 #include "table.h"
+#include "manager.h"
+#include <sys/mman.h>
 
 RC IndexHash::init(uint64_t bucket_cnt, int part_cnt) {
-  _bucket_cnt = bucket_cnt;
-  _bucket_cnt_per_part = bucket_cnt / part_cnt;
-  _buckets = new BucketHeader * [part_cnt];
+  _part_cnt = part_cnt;
+  // bucket indexes are masked, so the bucket count is a power of 2
+  uint64_t bkt_cnt = 1;
+  while (bkt_cnt < bucket_cnt / part_cnt)
+    bkt_cnt *= 2;
+  _parts = new HashPart [part_cnt];
   for (int i = 0; i < part_cnt; i++) {
-    _buckets[i] = (BucketHeader *) _mm_malloc(sizeof(BucketHeader) * _bucket_cnt_per_part, 64);
-    for (uint32_t n = 0; n < _bucket_cnt_per_part; n ++)
-      _buckets[i][n].init();
+    HashPart * part = &_parts[i];
+    // a small index does not pay for a large segment
+    uint64_t seg_size = min(HASH_SEG_SIZE, max(HASH_MIN_SEG_SIZE, bkt_cnt));
+    part->seg_shift = __builtin_ctzl(seg_size);
+    part->seg_cnt = max(HASH_MIN_SEG_CNT, (bkt_cnt << HASH_MAX_GROW) / seg_size);
+    part->segments = new BucketNode * [part->seg_cnt];
+    for (uint64_t s = 0; s < part->seg_cnt; s++)
+      part->segments[s] = NULL;
+    // the initial buckets are placed with the partition
+    uint64_t init_seg_cnt = (bkt_cnt + seg_size - 1) / seg_size;
+    uint64_t seg_bytes = sizeof(BucketNode) * seg_size;
+    char * segs = (char *) mem_allocator.alloc_region(seg_bytes * init_seg_cnt, i);
+    if (segs == NULL)
+      segs = (char *) _mm_malloc(seg_bytes * init_seg_cnt, 64);
+    memset(segs, 0, seg_bytes * init_seg_cnt);
+    for (uint64_t s = 0; s < init_seg_cnt; s++)
+      part->segments[s] = (BucketNode *) (segs + s * seg_bytes);
+    part->bucket_cnt = bkt_cnt;
+    part->node_cnt = 0;
+    part->remove_latch = false;
+    // bucket 0 heads the list, every other bucket is linked in lazily
+    part->segments[0][0].init(0, dummy_key(0));
+    part->segments[0][0].items = HASH_BKT_LINKED;
   }
   return RCOK;
 }
@@ -27,123 +52,274 @@ bool IndexHash::index_exist(idx_key_t key) {
   return false;
 }
 
-void
-IndexHash::get_latch(BucketHeader * bucket) {
-  while (!ATOM_CAS(bucket->locked, false, true)) {}
+double IndexHash::load_factor() {
+  uint64_t node_cnt = 0;
+  uint64_t bucket_cnt = 0;
+  for (int i = 0; i < _part_cnt; i++) {
+    node_cnt += _parts[i].node_cnt;
+    bucket_cnt += _parts[i].bucket_cnt;
+  }
+  return (double) node_cnt / bucket_cnt;
 }
 
-void
-IndexHash::release_latch(BucketHeader * bucket) {
-    bool ok = ATOM_CAS(bucket->locked, true, false);
-    assert(ok);
-  // XXX(zhihan): change to read/write lock
-  //pthread_rwlock_unlock(bucket->rwlock);
+BucketNode *
+IndexHash::get_bucket(HashPart * part, uint64_t bkt_idx, int part_id) {
+  uint64_t seg_idx = bkt_idx >> part->seg_shift;
+  BucketNode * seg = ATOM_LOAD_ACQ(part->segments[seg_idx]);
+  if (seg == NULL) {
+    // anonymous pages read as zero, so the txn that first touches the
+    // segment does not clear it
+    uint64_t seg_bytes = sizeof(BucketNode) << part->seg_shift;
+    BucketNode * new_seg = (BucketNode *) mmap(NULL, seg_bytes,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    M_ASSERT(new_seg != MAP_FAILED, "cannot map a hash segment");
+    seg = NULL;
+    if (ATOM_CAS_REL(part->segments[seg_idx], seg, new_seg))
+      seg = new_seg;
+    else
+      munmap(new_seg, seg_bytes);
+  }
+  BucketNode * bucket = &seg[bkt_idx & ((1UL << part->seg_shift) - 1)];
+  if (ATOM_LOAD_ACQ(bucket->items) != HASH_BKT_LINKED)
+    init_bucket(part, bkt_idx, bucket, part_id);
+  return bucket;
 }
 
 void
-IndexHash::get_latch(BucketHeader * bucket, access_t access) {
-  while (!ATOM_CAS(bucket->locked, false, true)) {}
-  /*
-  // XXX(zhihan): rwlock
-  if (access == RD)
-    pthread_rwlock_rdlock(bucket->rwlock);
-  else
-    pthread_rwlock_wrlock(bucket->rwlock);
-  */
+IndexHash::init_bucket(HashPart * part, uint64_t bkt_idx,
+                       BucketNode * bucket, int part_id) {
+  itemid_t * state = NULL;
+  if (!ATOM_CAS_REL(bucket->items, state, HASH_BKT_CLAIMED)) {
+    // another thread is linking the bucket
+    while (ATOM_LOAD_ACQ(bucket->items) != HASH_BKT_LINKED)
+      PAUSE
+    return;
+  }
+  // the parent drops the top bit, its keys are a superset of bkt_idx's
+  uint64_t parent = bkt_idx & ~(1UL << (63 - __builtin_clzl(bkt_idx)));
+  BucketNode * start = get_bucket(part, parent, part_id);
+  bucket->key = 0;
+  bucket->so_key = dummy_key(bkt_idx);
+  BucketNode * prev;
+  BucketNode * cur;
+  do {
+    find(start, bucket->so_key, 0, prev, cur);
+    bucket->next = cur;
+  } while (!ATOM_CAS_REL(prev->next, cur, bucket));
+  state = HASH_BKT_CLAIMED;
+  ATOM_CAS_REL(bucket->items, state, HASH_BKT_LINKED);
+}
+
+BucketNode *
+IndexHash::find(BucketNode * start, uint64_t so_key, idx_key_t key,
+                BucketNode * &prev, BucketNode * &cur) {
+retry:
+  // start is a dummy node, those are never removed
+  prev = start;
+  cur = ATOM_LOAD_ACQ(start->next);
+  while (cur != NULL) {
+    BucketNode * next = ATOM_LOAD_ACQ(cur->next);
+    if (is_marked(next)) {
+      // cur is being removed and counts as absent, help to unlink it. if
+      // prev changed or is being removed itself, walk again
+      BucketNode * expected = cur;
+      if (!ATOM_CAS_REL(prev->next, expected, unmark(next)))
+        goto retry;
+      cur = unmark(next);
+      continue;
+    }
+    if (cur->so_key > so_key || (cur->so_key == so_key && cur->key >= key))
+      break;
+    prev = cur;
+    cur = next;
+  }
+  if (cur != NULL && cur->so_key == so_key && cur->key == key)
+    return cur;
+  return NULL;
+}
+
+BucketNode * IndexHash::find_node(idx_key_t key, int part_id) {
+  HashPart * part = &_parts[part_id];
+  uint64_t h = hash(key);
+  BucketNode * start = get_bucket(part, h & (part->bucket_cnt - 1), part_id);
+  BucketNode * prev;
+  BucketNode * cur;
+  return find(start, regular_key(h), key, prev, cur);
 }
 
 RC IndexHash::index_insert(idx_key_t key, itemid_t * item, int part_id) {
-  RC rc = RCOK;
-  uint64_t bkt_idx = hash(key);
-  assert(bkt_idx < _bucket_cnt_per_part);
-  BucketHeader * cur_bkt = &_buckets[part_id][bkt_idx];
-  // 1. get the ex latch
-  get_latch(cur_bkt, WR);
-  // 2. update the latch list
-  cur_bkt->insert_item(key, item, part_id);
-  // 3. release the latch
-  release_latch(cur_bkt);
-  return rc;
+  HashPart * part = &_parts[part_id];
+  uint64_t h = hash(key);
+  uint64_t so_key = regular_key(h);
+  BucketNode * start = get_bucket(part, h & (part->bucket_cnt - 1), part_id);
+  BucketNode * new_node = NULL;
+  // in_region() cannot be asked while parallel loaders still carve regions
+  bool new_in_region = false;
+  BucketNode * prev;
+  BucketNode * cur;
+  BucketNode * node;
+  // no latch, the node or item is published with one CAS
+  while (true) {
+    while ((node = find(start, so_key, key, prev, cur)) == NULL) {
+      if (new_node == NULL) {
+        new_node = (BucketNode *)
+            mem_allocator.alloc_region(sizeof(BucketNode), part_id);
+        new_in_region = (new_node != NULL);
+        if (!new_in_region)
+          new_node = (BucketNode *)
+              mem_allocator.alloc(sizeof(BucketNode), part_id);
+        new_node->init(key, so_key);
+      }
+      item->next = NULL;
+      new_node->items = item;
+      new_node->next = cur;
+      if (ATOM_CAS_REL(prev->next, cur, new_node)) {
+        // doubling only bumps the count, the new buckets split off lazily
+        uint64_t bucket_cnt = part->bucket_cnt;
+        if (ATOM_ADD_FETCH(part->node_cnt, 1) > bucket_cnt * HASH_LOAD_FACTOR
+            && bucket_cnt * 2 <= part->seg_cnt << part->seg_shift)
+          ATOM_CAS(part->bucket_cnt, bucket_cnt, bucket_cnt * 2);
+        return RCOK;
+      }
+      // lost to another insert or a removal, walk again from the bucket
+    }
+    itemid_t * items = ATOM_LOAD_ACQ(node->items);
+    while (!is_marked(items)) {
+      item->next = items;
+      if (ATOM_CAS_REL(node->items, items, item)) {
+        if (new_node != NULL && !new_in_region)
+          mem_allocator.free(new_node, sizeof(BucketNode));
+        return RCOK;
+      }
+    }
+    // the node is being removed, once it is unlinked the key gets a new one
+    PAUSE
+  }
 }
 
 RC IndexHash::index_read(idx_key_t key, itemid_t * &item, int part_id) {
-  //TODO(zhihan): take read lock
-  uint64_t bkt_idx = hash(key);
-  assert(bkt_idx < _bucket_cnt_per_part);
-  BucketHeader * cur_bkt = &_buckets[part_id][bkt_idx];
-  RC rc = RCOK;
-  // 1. get the sh latch
-  //get_latch(cur_bkt, RD);
-  cur_bkt->read_item(key, item, table->get_table_name());
-  // 3. release the latch
-  //release_latch(cur_bkt);
-  return rc;
-
+  BucketNode * node = find_node(key, part_id);
+  M_ASSERT(node != NULL, "Key does not exist!");
+  item = unmark(ATOM_LOAD_ACQ(node->items));
+  return RCOK;
 }
 
 RC IndexHash::index_read(idx_key_t key, itemid_t * &item,
                          int part_id, int thd_id) {
-  uint64_t bkt_idx = hash(key);
-  assert(bkt_idx < _bucket_cnt_per_part);
-  BucketHeader * cur_bkt = &_buckets[part_id][bkt_idx];
-  RC rc = RCOK;
-  // 1. get the sh latch
-  //get_latch(cur_bkt, RD);
-  cur_bkt->read_item(key, item, table->get_table_name());
-  // 3. release the latch
-  //release_latch(cur_bkt);
-  return rc;
-}
-
-/************** BucketHeader Operations ******************/
-
-void BucketHeader::init() {
-  node_cnt = 0;
-  first_node = NULL;
-  locked = false;
-  // XXX(zhihan): init another rw lock
-  rwlock = new pthread_rwlock_t;
-  pthread_rwlock_init(rwlock, NULL);
-}
-
-void BucketHeader::insert_item(idx_key_t key,
-                               itemid_t * item,
-                               int part_id)
-{
-  BucketNode * cur_node = first_node;
-  BucketNode * prev_node = NULL;
-  while (cur_node != NULL) {
-    if (cur_node->key == key)
-      break;
-    prev_node = cur_node;
-    cur_node = cur_node->next;
+  BucketNode * node = find_node(key, part_id);
+  M_ASSERT(node != NULL, "Key does not exist!");
+  item = unmark(ATOM_LOAD_ACQ(node->items));
+  return RCOK;
+}
+
+void IndexHash::start_probe(HashProbe &probe, uint32_t idx, idx_key_t key, int part_id) {
+  uint64_t h = hash(key);
+  probe.idx = idx;
+  probe.stage = PROBE_BUCKET;
+  probe.part_id = part_id;
+  probe.bkt_idx = h & (_parts[part_id].bucket_cnt - 1);
+  probe.so_key = regular_key(h);
+  prefetch(key, part_id);
+}
+
+bool IndexHash::step_probe(HashProbe &probe, idx_key_t key, itemid_t ** items) {
+  if (probe.stage == PROBE_BUCKET) {
+    BucketNode * bucket = get_bucket(&_parts[probe.part_id], probe.bkt_idx, probe.part_id);
+    probe.node = unmark(ATOM_LOAD_ACQ(bucket->next));
+    probe.stage = PROBE_WALK;
+  } else if (probe.stage == PROBE_WALK) {
+    BucketNode * node = probe.node;
+    M_ASSERT(node != NULL && (node->so_key < probe.so_key
+        || (node->so_key == probe.so_key && node->key <= key)), "Key does not exist!");
+    // a node being removed counts as absent, as in find()
+    if (node->so_key == probe.so_key && node->key == key
+        && !is_marked(ATOM_LOAD_ACQ(node->next))) {
+      items[probe.idx] = unmark(ATOM_LOAD_ACQ(node->items));
+      __builtin_prefetch(items[probe.idx]);
+      probe.stage = PROBE_ITEM;
+      return false;
+    }
+    probe.node = unmark(ATOM_LOAD_ACQ(node->next));
+  } else {
+    __builtin_prefetch(items[probe.idx]->location);
+    return true;
+  }
+  if (probe.node != NULL)
+    __builtin_prefetch(probe.node);
+  return false;
+}
+
+RC IndexHash::index_read_batch(idx_key_t * keys, int * part_ids,
+                               uint32_t cnt, itemid_t ** items, int thd_id) {
+  HashProbe probes[IDX_BATCH_GROUP];
+  uint32_t next = 0;
+  uint32_t active = 0;
+  for (uint32_t s = 0; s < IDX_BATCH_GROUP; s++) {
+    probes[s].idx = cnt;
+    if (next < cnt) {
+      start_probe(probes[s], next, keys[next], part_ids[next]);
+      next ++;
+      active ++;
+    }
   }
-  if (cur_node == NULL) {
-    BucketNode * new_node = (BucketNode *)
-        mem_allocator.alloc(sizeof(BucketNode), part_id );
-    new_node->init(key);
-    new_node->items = item;
-    if (prev_node != NULL) {
-      new_node->next = prev_node->next;
-      prev_node->next = new_node;
+  for (uint32_t s = 0; active > 0; s = (s + 1) % IDX_BATCH_GROUP) {
+    HashProbe &probe = probes[s];
+    if (probe.idx == cnt || !step_probe(probe, keys[probe.idx], items))
+      continue;
+    // the slot takes the next key
+    if (next < cnt) {
+      start_probe(probe, next, keys[next], part_ids[next]);
+      next ++;
     } else {
-      new_node->next = first_node;
-      first_node = new_node;
+      probe.idx = cnt;
+      active --;
     }
-  } else {
-    item->next = cur_node->items;
-    cur_node->items = item;
   }
+  return RCOK;
 }
 
-void BucketHeader::read_item(idx_key_t key, itemid_t * &item, const char * tname)
-{
-  BucketNode * cur_node = first_node;
-  while (cur_node != NULL) {
-    if (cur_node->key == key)
-      break;
-    cur_node = cur_node->next;
+// frees a removed node and its items, loaded ones stay in their region
+static void free_bucket_node(void * ptr) {
+  BucketNode * node = (BucketNode *) ptr;
+  itemid_t * item = IndexHash::unmark(node->items);
+  while (item != NULL) {
+    itemid_t * next = item->next;
+    if (!mem_allocator.in_region(item))
+      mem_allocator.free(item, sizeof(itemid_t));
+    item = next;
   }
-  M_ASSERT(cur_node->key == key, "Key does not exist!");
-  item = cur_node->items;
+  if (!mem_allocator.in_region(node))
+    mem_allocator.free(node, sizeof(BucketNode));
+}
+
+RC IndexHash::index_remove(idx_key_t key, int part_id) {
+  HashPart * part = &_parts[part_id];
+  uint64_t h = hash(key);
+  uint64_t so_key = regular_key(h);
+  BucketNode * start = get_bucket(part, h & (part->bucket_cnt - 1), part_id);
+  BucketNode * prev;
+  BucketNode * cur;
+  while (!ATOM_CAS(part->remove_latch, false, true)) {}
+  BucketNode * node = find(start, so_key, key, prev, cur);
+  if (node == NULL) {
+    part->remove_latch = false;
+    return ERROR;
+  }
+  // once items is marked no insert adds to the node, once next is marked
+  // no insert links behind it and lookups treat it as absent
+  itemid_t * items;
+  do {
+    items = ATOM_LOAD_ACQ(node->items);
+  } while (!ATOM_CAS(node->items, items, mark(items)));
+  BucketNode * next;
+  do {
+    next = ATOM_LOAD_ACQ(node->next);
+  } while (!ATOM_CAS(node->next, next, mark(next)));
+  // a reader standing on node still finds the rest of the list. the walk
+  // unlinks the node unless another one already did
+  find(start, so_key, key, prev, cur);
+  ATOM_SUB(part->node_cnt, 1);
+  part->remove_latch = false;
+  glob_manager->retire(node, free_bucket_node);
+  return RCOK;
 }
@@ -4,36 +4,75 @@
 #include "helper.h"
 #include "index_base.h"
 
+// Each partition is a split-ordered list (Shalev & Shavit): all keys sit in
+// one lock-free list sorted by their bit-reversed hash, and a bucket is a
+// dummy node marking where its keys start. Doubling the bucket count moves
+// no node, a new bucket is linked in by the first access that hashes to it.
+// The dummy nodes live in segments as large as the initial bucket count,
+// within [HASH_MIN_SEG_SIZE, HASH_SEG_SIZE] buckets.
+#define HASH_SEG_SIZE 				(1UL << 16)
+#define HASH_MIN_SEG_SIZE 			(1UL << 10)
+// bucket count may grow up to 2^HASH_MAX_GROW times the initial one, and
+// to at least HASH_MIN_SEG_CNT segments
+#define HASH_MAX_GROW 				10
+#define HASH_MIN_SEG_CNT 			1024UL
+// set on BucketNode::items and then BucketNode::next by index_remove before
+// the node is unlinked
+#define HASH_MARK 					1UL
+// a dummy node has no items, its items field tracks whether it is linked
+#define HASH_BKT_CLAIMED 			((itemid_t *) 1)
+#define HASH_BKT_LINKED 			((itemid_t *) 2)
+
 //TODO make proper variables private
 // each BucketNode contains items sharing the same key
 class BucketNode {
  public:
-  BucketNode(idx_key_t key) {	init(key); };
-  void init(idx_key_t key) {
+  BucketNode(idx_key_t key) {	init(key, 0); };
+  void init(idx_key_t key, uint64_t so_key) {
     this->key = key;
+    this->so_key = so_key;
     next = NULL;
     items = NULL;
   }
+  // dummy nodes have an even so_key and no items
+  bool is_dummy() { return (so_key & 1) == 0; }
   idx_key_t 		key;
-  // The node for the next key
+  // bit-reversed hash, the list order
+  uint64_t 		so_key;
+  // The node for the next key, set before the node is published
   BucketNode * 	next;
   // NOTE. The items can be a list of items connected by the next pointer.
+  // New items are pushed at the head by CAS.
   itemid_t * 		items;
 };
 
-// BucketHeader does concurrency control of Hash
-class BucketHeader {
- public:
-  void init();
-  void insert_item(idx_key_t key, itemid_t * item, int part_id);
-  void read_item(idx_key_t key, itemid_t * &item, const char * tname);
-  BucketNode * 	first_node;
-  uint64_t 		node_cnt;
-  bool 			locked;
-  pthread_rwlock_t * rwlock;
+// Nodes and items are published with a single release CAS, readers walk the
+// list with acquire loads and take no latch. remove_latch only serializes
+// removals.
+struct HashPart {
+  // segments of 2^seg_shift dummy nodes. The initial ones are allocated by
+  // init(), the ones doubling adds are mapped on first use and zeroed by the
+  // kernel page by page
+  BucketNode ** 			segments;
+  uint64_t 				seg_cnt;
+  uint32_t 				seg_shift;
+  uint64_t volatile 		bucket_cnt;
+  uint64_t volatile 		node_cnt;
+  bool volatile 			remove_latch;
+};
+
+// one lookup of index_read_batch() in flight
+enum probe_stage_t {PROBE_BUCKET, PROBE_WALK, PROBE_ITEM};
+struct HashProbe {
+  // position in the batch, the batch size while the slot is idle
+  uint32_t 		idx;
+  probe_stage_t 	stage;
+  int 			part_id;
+  uint64_t 		bkt_idx;
+  uint64_t 		so_key;
+  BucketNode * 	node;
 };
 
-// TODO Hash index does not support partition yet.
 class IndexHash  : public index_base
 {
  public:
@@ -47,15 +86,63 @@ class IndexHash  : public index_base
   RC	 		index_read(idx_key_t key, itemid_t * &item, int part_id=-1);
   RC	 		index_read(idx_key_t key, itemid_t * &item,
                            int part_id=-1, int thd_id=0);
+  // AMAC: IDX_BATCH_GROUP lookups advance round-robin by one cache line
+  // each, and every step prefetches the line its lookup needs next
+  RC 			index_read_batch(idx_key_t * keys, int * part_ids,
+                                 uint32_t cnt, itemid_t ** items, int thd_id=0);
+  // readers do not latch the bucket, so the node and its items are retired
+  // to Manager::retire() and freed after the txns that may hold them end
+  RC 			index_remove(idx_key_t key, int part_id=-1);
+  // start loading the bucket of key ahead of index_read
+  void 		prefetch(idx_key_t key, int part_id) {
+    HashPart * part = &_parts[part_id];
+    uint64_t b = hash(key) & (part->bucket_cnt - 1);
+    BucketNode * seg = ATOM_LOAD_ACQ(part->segments[b >> part->seg_shift]);
+    if (seg != NULL)
+      __builtin_prefetch(&seg[b & ((1UL << part->seg_shift) - 1)]);
+  }
+  // keys per bucket over all partitions
+  double 		load_factor();
+  template <typename T> static T * mark(T * ptr) {
+    return (T *) ((uint64_t) ptr | HASH_MARK);
+  }
+  template <typename T> static T * unmark(T * ptr) {
+    return (T *) ((uint64_t) ptr & ~HASH_MARK);
+  }
+  template <typename T> static bool is_marked(T * ptr) {
+    return ((uint64_t) ptr & HASH_MARK) != 0;
+  }
  private:
-  void get_latch(BucketHeader * bucket);
-  void get_latch(BucketHeader * bucket, access_t access);
-  void release_latch(BucketHeader * bucket);
+  BucketNode * get_bucket(HashPart * part, uint64_t bkt_idx, int part_id);
+  // links the dummy node of bkt_idx behind the one of its parent bucket
+  void 		init_bucket(HashPart * part, uint64_t bkt_idx,
+                            BucketNode * bucket, int part_id);
+  // returns the node of (so_key, key) or NULL. prev is left on the last
+  // node ordered before it and cur on the first one not ordered before it.
+  BucketNode * find(BucketNode * start, uint64_t so_key, idx_key_t key,
+                    BucketNode * &prev, BucketNode * &cur);
+  BucketNode * find_node(idx_key_t key, int part_id);
+  void 		start_probe(HashProbe &probe, uint32_t idx, idx_key_t key, int part_id);
+  // true once items[probe.idx] is resolved and its row requested
+  bool 		step_probe(HashProbe &probe, idx_key_t key, itemid_t ** items);
 
-  // TODO implement more complex hash function
-  uint64_t hash(idx_key_t key) {	return key % _bucket_cnt_per_part; }
+  // keys are mostly dense, so neighbouring keys keep neighbouring buckets.
+  // Folding the high bits down spreads composite keys whose low bits are
+  // few (custNPKey). The top bit is dropped to leave so_key room for the
+  // dummy/regular bit.
+  uint64_t hash(idx_key_t key) {
+    key ^= (key >> 16) ^ (key >> 32) ^ (key >> 48);
+    return key & ~(1UL << 63);
+  }
+  static uint64_t reverse_bits(uint64_t x) {
+    x = ((x >> 1) & 0x5555555555555555UL) | ((x & 0x5555555555555555UL) << 1);
+    x = ((x >> 2) & 0x3333333333333333UL) | ((x & 0x3333333333333333UL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FUL) | ((x & 0x0F0F0F0F0F0F0F0FUL) << 4);
+    return __builtin_bswap64(x);
+  }
+  static uint64_t regular_key(uint64_t h) { return reverse_bits(h) | 1; }
+  static uint64_t dummy_key(uint64_t bkt_idx) { return reverse_bits(bkt_idx); }
 
-  BucketHeader ** 	_buckets;
-  uint64_t	 		_bucket_cnt;
-  uint64_t 			_bucket_cnt_per_part;
+  HashPart * 		_parts;
+  int 				_part_cnt;
 };
@@ -0,0 +1,263 @@
+#include "global.h"
+#include "index_simd.h"
+#include "manager.h"
+#include "mem_alloc.h"
+#include "table.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// bit i is set if keys[i] == key
+static inline uint32_t simd_match(const volatile uint64_t * keys, uint64_t key) {
+  const uint64_t * k = (const uint64_t *) keys;
+#if defined(__AVX2__)
+  __m256i probe = _mm256_set1_epi64x(key);
+  __m256i lo = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i *) k), probe);
+  __m256i hi = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i *) (k + 4)), probe);
+  return _mm256_movemask_pd(_mm256_castsi256_pd(lo))
+      | (_mm256_movemask_pd(_mm256_castsi256_pd(hi)) << 4);
+#elif defined(__SSE2__)
+  __m128i probe = _mm_set1_epi64x(key);
+  uint32_t mask = 0;
+  for (int i = 0; i < SIMD_SLOTS; i += 2) {
+    __m128i eq = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *) (k + i)), probe);
+    // SSE2 compares 32-bit lanes, both halves of a key have to match
+    eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+    mask |= _mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+  }
+  return mask;
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < SIMD_SLOTS; i++)
+    if (k[i] == key)
+      mask |= 1 << i;
+  return mask;
+#endif
+}
+
+static void free_table(void * ptr) {
+  SimdTable * t = (SimdTable *) ptr;
+  _mm_free(t->buckets);
+  delete t;
+}
+
+// frees the items chained behind a removed key, loaded ones stay in their
+// region
+static void free_items(void * ptr) {
+  itemid_t * item = (itemid_t *) ptr;
+  while (item != NULL) {
+    itemid_t * next = item->next;
+    if (!mem_allocator.in_region(item))
+      mem_allocator.free(item, sizeof(itemid_t));
+    item = next;
+  }
+}
+
+RC IndexSimd::init(uint64_t bucket_cnt, int part_cnt) {
+  _part_cnt = part_cnt;
+  // bucket_cnt is the slot count IndexHash would get, keep it a power of 2
+  uint64_t slot_cnt = SIMD_SLOTS;
+  while (slot_cnt < bucket_cnt / part_cnt)
+    slot_cnt *= 2;
+  _tables = new SimdTable * [part_cnt];
+  _resize_locks = new pthread_rwlock_t [part_cnt];
+  for (int i = 0; i < part_cnt; i++) {
+    _tables[i] = new_table(slot_cnt / SIMD_SLOTS);
+    pthread_rwlock_init(&_resize_locks[i], NULL);
+  }
+  _stripes = new bool [SIMD_STRIPE_CNT];
+  for (uint32_t i = 0; i < SIMD_STRIPE_CNT; i++)
+    _stripes[i] = false;
+  return RCOK;
+}
+
+RC
+IndexSimd::init(int part_cnt, table_t * table, uint64_t bucket_cnt) {
+  init(bucket_cnt, part_cnt);
+  this->table = table;
+  return RCOK;
+}
+
+SimdTable * IndexSimd::new_table(uint64_t bucket_cnt) {
+  SimdTable * t = new SimdTable;
+  t->buckets = (SimdBucket *) _mm_malloc(sizeof(SimdBucket) * bucket_cnt, 64);
+  for (uint64_t b = 0; b < bucket_cnt; b++)
+    for (int i = 0; i < SIMD_SLOTS; i++)
+      t->buckets[b].keys[i] = SIMD_KEY_EMPTY;
+  t->bucket_mask = bucket_cnt - 1;
+  t->key_cnt = 0;
+  t->tomb_cnt = 0;
+  return t;
+}
+
+bool IndexSimd::index_exist(idx_key_t key) {
+  for (int p = 0; p < _part_cnt; p++)
+    if (find(ATOM_LOAD_ACQ(_tables[p]), key, hash(key)) != NULL)
+      return true;
+  return false;
+}
+
+SimdBucket * IndexSimd::find_slot(SimdTable * t, idx_key_t key, uint64_t h, int &slot) {
+  uint64_t b = h & t->bucket_mask;
+  // the table is never full, a bucket with an empty slot ends the probe
+  while (true) {
+    SimdBucket * bkt = &t->buckets[b];
+    uint32_t match = simd_match(bkt->keys, key);
+    if (match) {
+      slot = __builtin_ctz(match);
+      // pairs with the release in claim_slot(), the item is written
+      ATOM_LOAD_ACQ(bkt->keys[slot]);
+      return bkt;
+    }
+    if (simd_match(bkt->keys, SIMD_KEY_EMPTY))
+      return NULL;
+    b = (b + 1) & t->bucket_mask;
+  }
+}
+
+itemid_t * IndexSimd::find(SimdTable * t, idx_key_t key, uint64_t h) {
+  int slot;
+  SimdBucket * bkt = find_slot(t, key, h, slot);
+  return bkt == NULL ? NULL : &bkt->items[slot];
+}
+
+itemid_t * IndexSimd::claim_slot(SimdTable * t, idx_key_t key, uint64_t h, itemid_t * item) {
+  uint64_t b = h & t->bucket_mask;
+  while (true) {
+    SimdBucket * bkt = &t->buckets[b];
+    uint32_t empty = simd_match(bkt->keys, SIMD_KEY_EMPTY);
+    while (empty) {
+      int i = __builtin_ctz(empty);
+      empty &= empty - 1;
+      // other stripes may race for the same slot
+      if (!ATOM_CAS(bkt->keys[i], SIMD_KEY_EMPTY, SIMD_KEY_BUSY))
+        continue;
+      bkt->items[i].type = item->type;
+      bkt->items[i].location = item->location;
+      bkt->items[i].valid = item->valid;
+      bkt->items[i].next = item->next;
+      // readers that see the key see the item
+      uint64_t busy = SIMD_KEY_BUSY;
+      ATOM_CAS_REL(bkt->keys[i], busy, key);
+      ATOM_ADD(t->key_cnt, 1);
+      return &bkt->items[i];
+    }
+    b = (b + 1) & t->bucket_mask;
+  }
+}
+
+RC IndexSimd::index_insert(idx_key_t key, itemid_t * item, int part_id) {
+  assert(key < SIMD_KEY_TOMB);
+  uint64_t h = hash(key);
+  bool volatile * stripe = &_stripes[(h + part_id) % SIMD_STRIPE_CNT];
+  pthread_rwlock_rdlock(&_resize_locks[part_id]);
+  while (!ATOM_CAS(*stripe, false, true)) {}
+  SimdTable * t = _tables[part_id];
+  itemid_t * head = find(t, key, h);
+  if (head == NULL) {
+    item->next = NULL;
+    claim_slot(t, key, h, item);
+    // the slot keeps a copy, nothing else frees the caller's item
+    if (!mem_allocator.regions_open() && !mem_allocator.in_region(item))
+      mem_allocator.free(item, sizeof(itemid_t));
+  } else {
+    // later items of a key hang off the inline one
+    itemid_t * next = head->next;
+    item->next = next;
+    ATOM_CAS_REL(head->next, next, item);
+  }
+  // t may be retired by a grow() as soon as the lock is released
+  bool full = t->key_cnt * 4 > (t->bucket_mask + 1) * SIMD_SLOTS * 3;
+  __sync_lock_release(stripe);
+  pthread_rwlock_unlock(&_resize_locks[part_id]);
+  if (full)
+    grow(part_id);
+  return RCOK;
+}
+
+void IndexSimd::grow(int part_id) {
+  pthread_rwlock_wrlock(&_resize_locks[part_id]);
+  SimdTable * t = _tables[part_id];
+  uint64_t slot_cnt = (t->bucket_mask + 1) * SIMD_SLOTS;
+  if (t->key_cnt * 4 <= slot_cnt * 3) {
+    pthread_rwlock_unlock(&_resize_locks[part_id]);
+    return;
+  }
+  // a table filled up by tombstones is only rebuilt
+  uint64_t bucket_cnt = t->bucket_mask + 1;
+  if ((t->key_cnt - t->tomb_cnt) * 2 > slot_cnt)
+    bucket_cnt *= 2;
+  SimdTable * nt = new_table(bucket_cnt);
+  for (uint64_t b = 0; b <= t->bucket_mask; b++) {
+    SimdBucket * bkt = &t->buckets[b];
+    for (int i = 0; i < SIMD_SLOTS; i++) {
+      if (bkt->keys[i] == SIMD_KEY_EMPTY || bkt->keys[i] == SIMD_KEY_TOMB)
+        continue;
+      claim_slot(nt, bkt->keys[i], hash(bkt->keys[i]), &bkt->items[i]);
+    }
+  }
+  // readers that load nt see its buckets
+  ATOM_CAS_REL(_tables[part_id], t, nt);
+  pthread_rwlock_unlock(&_resize_locks[part_id]);
+  // readers may still probe the old table. Without EPOCH_RECLAIM nothing
+  // tells when they are done, so it is kept
+  if (EPOCH_RECLAIM)
+    glob_manager->retire(t, free_table);
+}
+
+RC IndexSimd::index_remove(idx_key_t key, int part_id) {
+  uint64_t h = hash(key);
+  bool volatile * stripe = &_stripes[(h + part_id) % SIMD_STRIPE_CNT];
+  pthread_rwlock_rdlock(&_resize_locks[part_id]);
+  while (!ATOM_CAS(*stripe, false, true)) {}
+  SimdTable * t = _tables[part_id];
+  int slot;
+  SimdBucket * bkt = find_slot(t, key, h, slot);
+  itemid_t * chain = NULL;
+  if (bkt != NULL) {
+    // the slot is not reused, a reader holding the inline item still sees it
+    chain = bkt->items[slot].next;
+    bkt->keys[slot] = SIMD_KEY_TOMB;
+    ATOM_ADD(t->tomb_cnt, 1);
+  }
+  __sync_lock_release(stripe);
+  pthread_rwlock_unlock(&_resize_locks[part_id]);
+  if (bkt == NULL)
+    return ERROR;
+  if (chain != NULL)
+    glob_manager->retire(chain, free_items);
+  return RCOK;
+}
+
+RC IndexSimd::index_read(idx_key_t key, itemid_t * &item, int part_id) {
+  item = find(ATOM_LOAD_ACQ(_tables[part_id]), key, hash(key));
+  M_ASSERT(item != NULL, "Key does not exist!");
+  return RCOK;
+}
+
+RC IndexSimd::index_read(idx_key_t key, itemid_t * &item,
+                         int part_id, int thd_id) {
+  item = find(ATOM_LOAD_ACQ(_tables[part_id]), key, hash(key));
+  M_ASSERT(item != NULL, "Key does not exist!");
+  return RCOK;
+}
+
+RC IndexSimd::index_read_batch(idx_key_t * keys, int * part_ids,
+                               uint32_t cnt, itemid_t ** items, int thd_id) {
+  // a probe is about one bucket, so whole groups advance stage by stage
+  for (uint32_t g = 0; g < cnt; g += IDX_BATCH_GROUP) {
+    uint32_t end = min(cnt, g + IDX_BATCH_GROUP);
+    for (uint32_t i = g; i < end; i++)
+      prefetch(keys[i], part_ids[i]);
+    for (uint32_t i = g; i < end; i++) {
+      items[i] = find(ATOM_LOAD_ACQ(_tables[part_ids[i]]), keys[i], hash(keys[i]));
+      M_ASSERT(items[i] != NULL, "Key does not exist!");
+      __builtin_prefetch(items[i]);
+    }
+    for (uint32_t i = g; i < end; i++)
+      __builtin_prefetch(items[i]->location);
+  }
+  return RCOK;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "global.h"
+#include "helper.h"
+#include "index_base.h"
+
+// [IDX_SIMD] open-addressing hash index. A bucket keeps the keys of its slots
+// in one cache line, compared against the probe key at once (AVX2, SSE2 or
+// scalar), followed by the itemids of the slots. A lookup touches the key
+// line, one itemid line and the row instead of walking header, node and
+// itemid. Further items of a key are chained from the inline itemid.
+// Buckets are probed linearly. A removed key leaves a tombstone that keeps
+// the probe going and is not reused, grow() drops the tombstones.
+#define SIMD_SLOTS 					8
+#define SIMD_KEY_EMPTY 				UINT64_MAX
+// slot claimed by an insert that has not written its key yet
+#define SIMD_KEY_BUSY 				(UINT64_MAX - 1)
+#define SIMD_KEY_TOMB 				(UINT64_MAX - 2)
+#define SIMD_STRIPE_CNT 			4096
+
+struct SimdBucket {
+  uint64_t volatile keys[SIMD_SLOTS];
+  itemid_t 		items[SIMD_SLOTS];
+};
+
+// one table per partition, rebuilt once it is 3/4 full. It doubles unless
+// most of the used slots are tombstones
+struct SimdTable {
+  SimdBucket * 	buckets;
+  uint64_t 		bucket_mask;
+  // used slots, tombstones included
+  uint64_t volatile key_cnt;
+  uint64_t volatile tomb_cnt;
+};
+
+class IndexSimd : public index_base
+{
+ public:
+  RC 			init(uint64_t bucket_cnt, int part_cnt);
+  RC 			init(int part_cnt,
+                     table_t * table,
+                     uint64_t bucket_cnt);
+  bool 		index_exist(idx_key_t key); // check if the key exist.
+  RC 			index_insert(idx_key_t key, itemid_t * item, int part_id=-1);
+  // the returned item lives in the table, it is not a copy
+  RC	 		index_read(idx_key_t key, itemid_t * &item, int part_id=-1);
+  RC	 		index_read(idx_key_t key, itemid_t * &item,
+                           int part_id=-1, int thd_id=0);
+  // prefetches the home buckets of IDX_BATCH_GROUP keys, then resolves them
+  // and prefetches their items and rows
+  RC 			index_read_batch(idx_key_t * keys, int * part_ids,
+                                 uint32_t cnt, itemid_t ** items, int thd_id=0);
+  // the inline item stays in the table until it is rebuilt, the chained
+  // ones are retired
+  RC 			index_remove(idx_key_t key, int part_id=-1);
+  // start loading the key line of key's home bucket
+  void 		prefetch(idx_key_t key, int part_id) {
+    SimdTable * t = ATOM_LOAD_ACQ(_tables[part_id]);
+    __builtin_prefetch(&t->buckets[hash(key) & t->bucket_mask]);
+  }
+ private:
+  SimdTable * 	new_table(uint64_t bucket_cnt);
+  // the bucket holding key in keys[slot], or NULL
+  SimdBucket * find_slot(SimdTable * t, idx_key_t key, uint64_t h, int &slot);
+  itemid_t * 	find(SimdTable * t, idx_key_t key, uint64_t h);
+  // copies item into a free slot for key, the caller holds the key's stripe
+  itemid_t * 	claim_slot(SimdTable * t, idx_key_t key, uint64_t h, itemid_t * item);
+  void 		grow(int part_id);
+
+  // murmur3 finalizer, spreads dense and composite keys over the buckets
+  uint64_t hash(idx_key_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdUL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53UL;
+    key ^= key >> 33;
+    return key;
+  }
+
+  SimdTable * volatile * _tables;
+  int 				_part_cnt;
+  // inserts of one key are serialized on its stripe
+  bool volatile * 	_stripes;
+  // inserts share it, grow() takes it exclusively
+  pthread_rwlock_t * _resize_locks;
+};
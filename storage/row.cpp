@@ -4,6 +4,7 @@
 #include "catalog.h"
 #include "row.h"
 #include "txn.h"
+#include "thread.h"
 #include "row_lock.h"
 #include "row_ts.h"
 #include "row_mvcc.h"
@@ -26,10 +27,14 @@ row_t::init(table_t * host_table, uint64_t part_id, uint64_t row_id) {
   this->table = host_table;
   Catalog * schema = host_table->get_schema();
   int tuple_size = schema->get_tuple_size();
-  data = (char *) _mm_malloc(sizeof(char) * tuple_size, 64);
+  data = (char *) mem_allocator.alloc_region(sizeof(char) * tuple_size, part_id);
+  if (data == NULL)
+    data = (char *) _mm_malloc(sizeof(char) * tuple_size, 64);
 #if CC_ALG == IC3
   txn_access = NULL;
   orig = NULL;
+#elif CC_ALG == BAMBOO
+  txn_access = NULL;
 #endif
   return RCOK;
 }
@@ -57,25 +62,37 @@ row_t::switch_schema(table_t * host_table) {
 
 void row_t::init_manager(row_t * row) {
 #if CC_ALG == DL_DETECT || CC_ALG == NO_WAIT || CC_ALG == WAIT_DIE
-  manager = (Row_lock *) mem_allocator.alloc(sizeof(Row_lock), _part_id);
+  manager = (Row_lock *) mem_allocator.alloc_load(sizeof(Row_lock), _part_id);
 #elif CC_ALG == TIMESTAMP
-  manager = (Row_ts *) mem_allocator.alloc(sizeof(Row_ts), _part_id);
+  manager = (Row_ts *) mem_allocator.alloc_load(sizeof(Row_ts), _part_id);
 #elif CC_ALG == MVCC
   manager = (Row_mvcc *) _mm_malloc(sizeof(Row_mvcc), 64);
 #elif CC_ALG == HEKATON
   manager = (Row_hekaton *) _mm_malloc(sizeof(Row_hekaton), 64);
 #elif CC_ALG == OCC
-  manager = (Row_occ *) mem_allocator.alloc(sizeof(Row_occ), _part_id);
+  manager = (Row_occ *) mem_allocator.alloc_load(sizeof(Row_occ), _part_id);
 #elif CC_ALG == TICTOC
   manager = (Row_tictoc *) _mm_malloc(sizeof(Row_tictoc), 64);
 #elif CC_ALG == SILO
   manager = (Row_silo *) _mm_malloc(sizeof(Row_silo), 64);
 #elif CC_ALG == VLL
-  manager = (Row_vll *) mem_allocator.alloc(sizeof(Row_vll), _part_id);
+  manager = (Row_vll *) mem_allocator.alloc_load(sizeof(Row_vll), _part_id);
 #elif CC_ALG == WOUND_WAIT
-  manager = (Row_ww *) mem_allocator.alloc(sizeof(Row_ww), _part_id);
+  manager = (Row_ww *) mem_allocator.alloc_load(sizeof(Row_ww), _part_id);
 #elif CC_ALG == BAMBOO
-  manager = (Row_bamboo *) mem_allocator.alloc(sizeof(Row_bamboo), _part_id);
+#if BB_FIELD_LOCKING
+  if (table->field_locking) {
+    // one lock manager per column, indexed by field id
+    UInt32 field_cnt = get_field_cnt();
+    manager = (Row_bamboo *) mem_allocator.alloc_load(sizeof(Row_bamboo) * field_cnt, _part_id);
+    for (UInt32 fid = 0; fid < field_cnt; fid++) {
+      new(&manager[fid]) Row_bamboo();
+      manager[fid].init(this, fid);
+    }
+    return;
+  }
+#endif
+  manager = (Row_bamboo *) mem_allocator.alloc_load(sizeof(Row_bamboo), _part_id);
   new(manager) Row_bamboo();
 #elif CC_ALG == IC3
   manager = (Row_ic3 *) _mm_malloc(sizeof(Row_ic3), 64);
@@ -105,16 +122,47 @@ uint64_t row_t::get_field_cnt() {
   return get_schema()->field_cnt;
 }
 
-void row_t::inc_value(int id, uint64_t val) {
+// the column is a double, other txns may add to it concurrently
+void row_t::inc_value(int id, double val) {
   int pos = get_schema()->get_field_index(id);
-  ATOM_ADD(data[pos], val);
+  uint64_t * ptr = (uint64_t *) &data[pos];
+  uint64_t old_bits, new_bits;
+  double v;
+  do {
+    old_bits = *ptr;
+    memcpy(&v, &old_bits, sizeof(v));
+    v += val;
+    memcpy(&new_bits, &v, sizeof(v));
+  } while (!ATOM_CAS(*ptr, old_bits, new_bits));
 }
 
-void row_t::dec_value(int id, uint64_t val) {
-  int pos = get_schema()->get_field_index(id);
-  ATOM_SUB(data[pos], val);
+void row_t::dec_value(int id, double val) {
+  inc_value(id, -val);
 }
 
+#if CC_ALG == BAMBOO
+// a column of a local copy is about to be written. the copy must not have
+// been retired yet, see txn_man::retire_threshold
+#if BB_AUTORETIRE
+#define BB_CHECK_NOT_RETIRED \
+  assert(txn_access->lock_entry->status != LOCK_RETIRED);
+#else
+#define BB_CHECK_NOT_RETIRED
+#endif
+#if BB_UNDO_LOG
+#define BB_MARK_DIRTY(id) { \
+  if (txn_access) { \
+    BB_CHECK_NOT_RETIRED \
+    txn_access->lock_entry->txn->log_undo(txn_access, id); \
+    txn_access->dirty_fields |= BB_DIRTY_BIT(id); } }
+#else
+#define BB_MARK_DIRTY(id) { \
+  if (txn_access) { \
+    BB_CHECK_NOT_RETIRED \
+    txn_access->dirty_fields |= BB_DIRTY_BIT(id); } }
+#endif
+#endif
+
 void row_t::set_value(int id, void * ptr) {
   int datasize = get_schema()->get_field_size(id);
   int pos = get_schema()->get_field_index(id);
@@ -122,6 +170,8 @@ void row_t::set_value(int id, void * ptr) {
   // assume no blind writes.
   if (txn_access)
     txn_access->wr_accesses = (txn_access->wr_accesses | (1UL << id));
+#elif CC_ALG == BAMBOO
+  BB_MARK_DIRTY(id);
 #endif
   memcpy( &data[pos], ptr, datasize);
   //debugging
@@ -135,6 +185,8 @@ void row_t::set_value(int id, void * ptr, int size) {
   // assume no blind writes.
   if (txn_access)
     txn_access->wr_accesses = (txn_access->wr_accesses | (1UL << id));
+#elif CC_ALG == BAMBOO
+  BB_MARK_DIRTY(id);
 #endif
   memcpy( &data[pos], ptr, size);
   //debugging
@@ -149,6 +201,7 @@ void row_t::set_value(const char * col_name, void * ptr) {
   if (txn_access)
     txn_access->wr_accesses = (txn_access->wr_accesses | (1UL << id));
 #endif
+  // bamboo marks the column in set_value(id, ptr)
   set_value(id, ptr);
 }
 
@@ -227,9 +280,41 @@ void row_t::free_row() {
   free(data);
 }
 
+void row_t::reclaim(void * ptr) {
+  row_t * row = (row_t *) ptr;
+  if (mem_allocator.in_region(row))
+    return;
+#if CC_ALG == BAMBOO && BB_FIELD_LOCKING
+  UInt32 mgr_cnt = row->table->field_locking ? row->get_field_cnt() : 1;
+  for (UInt32 i = 0; i < mgr_cnt; i++)
+    row->manager[i].destroy();
+#elif CC_ALG == BAMBOO || CC_ALG == WOUND_WAIT || CC_ALG == DL_DETECT || CC_ALG == NO_WAIT || CC_ALG == WAIT_DIE
+  row->manager->destroy();
+#endif
+#if CC_ALG == MVCC || CC_ALG == HEKATON || CC_ALG == TICTOC || CC_ALG == SILO || CC_ALG == IC3
+  _mm_free(row->manager);
+#elif CC_ALG != HSTORE && CC_ALG != OCC
+  mem_allocator.free(row->manager, 0);
+#endif
+  row->free_row();
+  _mm_free(row);
+}
+
 #if CC_ALG == BAMBOO
 RC row_t::retire_row(BBLockEntry * lock_entry) {
-  return this->manager->lock_retire(lock_entry);
+  return get_manager(lock_entry->access)->lock_retire(lock_entry);
+}
+
+// lock manager of the tuple, or of the accessed column if the table is
+// locked at field granularity
+Row_bamboo * row_t::get_manager(Access * access) {
+#if BB_FIELD_LOCKING
+  if (table->field_locking) {
+    assert(access->fid >= 0);
+    return &manager[access->fid];
+  }
+#endif
+  return manager;
 }
 #endif
 
@@ -241,6 +326,10 @@ RC row_t::get_row(access_t type, txn_man * txn, row_t *& row, Access * access) {
 #elif CC_ALG == WAIT_DIE || CC_ALG == NO_WAIT || CC_ALG == DL_DETECT || CC_ALG == WOUND_WAIT || CC_ALG == BAMBOO
   uint64_t thd_id = txn->get_thd_id();
   lock_t lt = (type == RD || type == SCAN)? LOCK_SH : LOCK_EX;
+  #if COMMUTATIVE_OPS && (CC_ALG == WOUND_WAIT || CC_ALG == BAMBOO)
+  if (type == CM)
+    lt = LOCK_COM;
+  #endif
   #if CC_ALG == DL_DETECT
   uint64_t * txnids;
   int txncnt;
@@ -250,7 +339,18 @@ RC row_t::get_row(access_t type, txn_man * txn, row_t *& row, Access * access) {
     row = NULL;
     return Abort;
   }
+  #if CC_ALG == BAMBOO
+  #if BB_RO_FASTPATH
+  if (txn->read_only && lt == LOCK_SH) {
+    rc = get_manager(access)->snapshot_read(txn, access);
+    row = this;
+    return rc;
+  }
+  #endif
+  rc = get_manager(access)->lock_get(lt, txn, access);
+  #else
   rc = this->manager->lock_get(lt, txn, access);
+  #endif
   #else
   assert(txn->get_ts() != 0);
   rc = this->manager->lock_get(lt, txn, access);
@@ -270,10 +370,27 @@ RC row_t::get_row(access_t type, txn_man * txn, row_t *& row, Access * access) {
     txn->lock_abort = false;
     #endif
     INC_STATS(txn->get_thd_id(), wait_cnt, 1);
+    #if CC_ALG == BAMBOO && BB_SPIN_PARK
+    uint64_t spins = 0;
+    uint32_t seq = txn->wake_seq;
+    #endif
     while (!txn->lock_ready && !txn->lock_abort)
     {
-    #if CC_ALG == WAIT_DIE || (CC_ALG == WOUND_WAIT) || (CC_ALG == BAMBOO)
+    #if CORO_PER_THREAD > 1
+      // the lock holder may be another txn of this thread
+      txn->h_thd->yield();
+    #elif CC_ALG == BAMBOO && BB_SPIN_PARK
+      txn->spin_or_park(spins, seq);
+    #endif
+    #if CC_ALG == WAIT_DIE || (CC_ALG == WOUND_WAIT) || (CC_ALG == BAMBOO && BB_MAX_DEPTH == 0)
       continue;
+    #elif CC_ALG == BAMBOO
+      // waits bounded by dependency depth may close a cycle through commit
+      // dependencies, break it with a timeout
+      if (get_sys_clock() - starttime > g_timeout) {
+        txn->set_abort();
+        break;
+      }
     #elif CC_ALG == DL_DETECT
       uint64_t last_detect = starttime;
       uint64_t last_try = starttime;
@@ -382,7 +499,7 @@ RC row_t::get_row(access_t type, txn_man * txn, row_t *& row, Access * access) {
 
 #if CC_ALG == BAMBOO
 void row_t::return_row(BBLockEntry * lock_entry, RC rc) {
-    this->manager->lock_release(lock_entry, rc);
+    get_manager(lock_entry->access)->lock_release(lock_entry, rc);
 }
 #elif CC_ALG == WOUND_WAIT
 void row_t::return_row(LockEntry * lock_entry, RC rc) {
@@ -75,8 +75,8 @@ class row_t
     char * get_value(int id);
     char * get_value_plain(uint64_t id);
     char * get_value(char * col_name);
-    void inc_value(int id, uint64_t val);
-    void dec_value(int id, uint64_t val);
+    void inc_value(int id, double val);
+    void dec_value(int id, double val);
 
     DECL_SET_VALUE(uint64_t);
     DECL_SET_VALUE(int64_t);
@@ -95,10 +95,15 @@ class row_t
     char * get_data();
 
     void free_row();
+    // frees a row retired by table_t::delete_row() or an aborted insert,
+    // with its data and lock manager. loaded rows stay in their region.
+    static void reclaim(void * ptr);
 
     // for concurrency control. can be lock, timestamp etc.
 #if CC_ALG == BAMBOO
     RC retire_row(BBLockEntry * lock_entry);
+    Row_bamboo * get_manager(Access * access);
+    Access * txn_access; // only used when row is a local copy
 #elif CC_ALG == IC3
     row_t * orig;
     void init_accesses(Access * access);
@@ -4,10 +4,12 @@
 #include "catalog.h"
 #include "row.h"
 #include "mem_alloc.h"
+#include "manager.h"
 
 void table_t::init(Catalog * schema) {
 	this->table_name = schema->table_name;
 	this->schema = schema;
+	this->field_locking = false;
 }
 
 RC table_t::get_new_row(row_t *& row) {
@@ -21,9 +23,16 @@ RC table_t::get_new_row(row_t *& row, uint64_t part_id, uint64_t &row_id) {
 	RC rc = RCOK;
 	cur_tab_size ++;
 	
-	row = (row_t *) _mm_malloc(sizeof(row_t), 64);
+	row = (row_t *) mem_allocator.alloc_region(sizeof(row_t), part_id);
+	if (row == NULL)
+		row = (row_t *) _mm_malloc(sizeof(row_t), 64);
 	rc = row->init(this, part_id, row_id);
 	row->init_manager(row);
 
 	return rc;
 }
+
+void table_t::delete_row(row_t * row) {
+	cur_tab_size --;
+	glob_manager->retire(row, row_t::reclaim);
+}
@@ -17,15 +17,19 @@ public:
 	RC get_new_row(row_t *& row); // this is equivalent to insert()
 	RC get_new_row(row_t *& row, uint64_t part_id, uint64_t &row_id);
 
-	void delete_row(); // TODO delete_row is not supportet yet
+	// the row must already be removed from the indexes. it is freed once no
+	// running txn can hold it.
+	void delete_row(row_t * row);
 
 	uint64_t get_table_size() { return cur_tab_size; };
 	Catalog * get_schema() { return schema; };
 	const char * get_table_name() { return table_name; };
 
 	Catalog * 		schema;
+	// [BAMBOO] rows keep one lock manager per column
+	bool			field_locking;
 private:
 	const char * 	table_name;
 	uint64_t  		cur_tab_size;
-	char 			pad[CL_SIZE - sizeof(void *)*3];
+	char 			pad[CL_SIZE - sizeof(void *)*4];
 };
@@ -148,9 +148,11 @@ typedef uint64_t (*func_ptr)(idx_key_t);	// part_id func_ptr(index_key);
 /* general concurrency control */
 enum access_t {RD, WR, XP, SCAN, CM};
 /* LOCK */
-enum lock_t {LOCK_EX, LOCK_SH, LOCK_NONE };
+// LOCK_COM: increment-only (COMMUTATIVE_OPS), shared with other LOCK_COM
+enum lock_t {LOCK_EX, LOCK_SH, LOCK_NONE, LOCK_COM};
 enum loc_t {RETIRED, OWNERS, WAITERS, LOC_NONE};
-enum lock_status {LOCK_DROPPED, LOCK_WAITER, LOCK_OWNER, LOCK_RETIRED};
+// LOCK_FASTPATH: [BAMBOO, LH_LOCKFREE] shared lock held without a list entry
+enum lock_status {LOCK_DROPPED, LOCK_WAITER, LOCK_OWNER, LOCK_RETIRED, LOCK_FASTPATH};
 /* TIMESTAMP */
 enum TsType {R_REQ, W_REQ, P_REQ, XP_REQ};
 /* TXN STATUS */
@@ -169,6 +171,8 @@ enum com_t {COM_INC, COM_DEC, COM_NONE};
 // index structure for specific purposes. (e.g. non-primary key access should use hash)
 #if (INDEX_STRUCT == IDX_BTREE)
 #define INDEX		index_btree
+#elif (INDEX_STRUCT == IDX_SIMD)
+#define INDEX		IndexSimd
 #else  // IDX_HASH
 #define INDEX		IndexHash
 #endif
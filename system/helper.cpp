@@ -2,6 +2,13 @@
 #include "helper.h"
 #include "mem_alloc.h"
 #include "time.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sched.h>
+#if PART_ALLOC
+#include <numa.h>
+#endif
 
 bool itemid_t::operator==(const itemid_t &other) const {
 	return (type == other.type && location == other.location);
@@ -33,6 +40,67 @@ uint64_t get_part_id(void * addr) {
 	return ((uint64_t)addr / PAGE_SIZE) % g_part_cnt; 
 }
 
+// node of each partition and cpu of each thread, set up by numa_place_init()
+static int * part_nodes = NULL;
+static int * thd_cpus = NULL;
+static uint32_t thd_cpu_cnt = 0;
+static thread_local int thd_node = -1;
+
+void numa_place_init() {
+#if PART_ALLOC
+	if (!g_part_alloc || numa_available() < 0)
+		return;
+	vector<vector<int> > node_cpus(numa_max_node() + 1);
+	for (int cpu = 0; cpu < numa_num_configured_cpus(); cpu++) {
+		int node = numa_node_of_cpu(cpu);
+		if (node >= 0)
+			node_cpus[node].push_back(cpu);
+	}
+	// nodes without cpus serve no partition
+	vector<int> nodes;
+	for (UInt32 n = 0; n < node_cpus.size(); n++)
+		if (!node_cpus[n].empty())
+			nodes.push_back(n);
+	if (nodes.empty())
+		return;
+	part_nodes = new int [g_part_cnt];
+	for (UInt32 p = 0; p < g_part_cnt; p++)
+		part_nodes[p] = nodes[p % nodes.size()];
+	// loaders are pinned the same way as the workers
+	thd_cpu_cnt = max(g_thread_cnt, g_init_parallelism);
+	thd_cpus = new int [thd_cpu_cnt];
+	vector<UInt32> used(node_cpus.size(), 0);
+	for (UInt32 t = 0; t < thd_cpu_cnt; t++) {
+		int node = part_nodes[t % g_part_cnt];
+		thd_cpus[t] = node_cpus[node][used[node]++ % node_cpus[node].size()];
+	}
+	printf("[numa] %lu nodes, partition 0 on node %d, partition %u on node %d\n",
+		nodes.size(), part_nodes[0], g_part_cnt - 1, part_nodes[g_part_cnt - 1]);
+#endif
+}
+
+int part_to_node(uint64_t part_id) {
+	if (part_nodes == NULL)
+		return -1;
+	return part_nodes[part_id % g_part_cnt];
+}
+
+int thread_node() {
+	return thd_node;
+}
+
+void pin_thread(uint64_t thd_id) {
+#if PART_ALLOC
+	if (thd_cpus == NULL || thd_id >= thd_cpu_cnt)
+		return;
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	CPU_SET(thd_cpus[thd_id], &mask);
+	if (sched_setaffinity(0, sizeof(cpu_set_t), &mask) == 0)
+		thd_node = numa_node_of_cpu(thd_cpus[thd_id]);
+#endif
+}
+
 uint64_t key_to_part(uint64_t key) {
 	if (g_part_alloc)
 		return key % g_part_cnt;
@@ -60,6 +128,27 @@ uint64_t merge_idx_key(uint64_t key1, uint64_t key2, uint64_t key3) {
 	return key1 << 42 | key2 << 21 | key3;
 }
 
+int perf_counter_open(uint32_t type, uint64_t config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+uint64_t perf_counter_close(int fd) {
+	uint64_t cnt = 0;
+	if (fd < 0)
+		return 0;
+	if (read(fd, &cnt, sizeof(cnt)) != sizeof(cnt))
+		cnt = 0;
+	close(fd);
+	return cnt;
+}
+
 /****************************************************/
 // Global Clock!
 /****************************************************/
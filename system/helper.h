@@ -25,6 +25,20 @@
 	__sync_fetch_and_add(&(dest), value)
 #define ATOM_SUB_FETCH(dest, value) \
 	__sync_sub_and_fetch(&(dest), value)
+#define ATOM_FETCH_OR(dest, value) \
+	__sync_fetch_and_or(&(dest), value)
+#define ATOM_FETCH_AND(dest, value) \
+	__sync_fetch_and_and(&(dest), value)
+// returns the old value
+#define ATOM_SWAP(dest, value) \
+	__sync_lock_test_and_set(&(dest), value)
+// publishes newval, stores before it are visible to ATOM_LOAD_ACQ readers.
+// on failure oldval is reloaded with the current value
+#define ATOM_CAS_REL(dest, oldval, newval) \
+	__atomic_compare_exchange_n(&(dest), &(oldval), newval, false, \
+		__ATOMIC_RELEASE, __ATOMIC_ACQUIRE)
+#define ATOM_LOAD_ACQ(src) \
+	__atomic_load_n(&(src), __ATOMIC_ACQUIRE)
 
 #define COMPILER_BARRIER asm volatile("" ::: "memory");
 #define PAUSE { __asm__ ( "pause;" ); }
@@ -261,7 +275,25 @@ private:
 	uint64_t seed;
 };
 
+// counts a hardware event of the calling thread in user space.
+// returns -1 if the kernel or the machine has no such counter.
+int perf_counter_open(uint32_t type, uint64_t config);
+// reads and closes the counter, 0 if fd is -1
+uint64_t perf_counter_close(int fd);
+
+// PART_ALLOC: spreads the partitions over the NUMA nodes and picks a cpu for
+// each thread on the node of partition thd_id % g_part_cnt, which is the
+// partition FIRST_PART_LOCAL queries start from.
+void numa_place_init();
+// node partition part_id is bound to, -1 if there is no placement
+int part_to_node(uint64_t part_id);
+// node the calling thread was pinned to by set_affinity(), -1 if none
+int thread_node();
+// no-op unless numa_place_init() placed the partitions
+void pin_thread(uint64_t thd_id);
+
 inline void set_affinity(uint64_t thd_id) {
+	pin_thread(thd_id);
 	return;
 	/*
 	// TOOD. the following mapping only works for swarm
@@ -5,12 +5,17 @@
 #include "thread.h"
 #include "manager.h"
 #include "mem_alloc.h"
+#include "index_hash.h"
 #include "query.h"
 #include "plock.h"
 #include "occ.h"
 #include "vll.h"
+#include "row_bamboo.h"
 
 void * f(void *);
+#if CC_ALG == BAMBOO && BB_WAITER_BENCH > 0
+static void bench_waiters(workload * wl, thread_t * thd);
+#endif
 
 thread_t ** m_thds;
 
@@ -21,6 +26,7 @@ int main(int argc, char* argv[])
 {
 	parser(argc, argv);
 	
+	numa_place_init();
 	mem_allocator.init(g_part_cnt, MEM_SIZE / g_part_cnt); 
 	stats.init();
 	glob_manager = (Manager *) _mm_malloc(sizeof(Manager), 64);
@@ -58,6 +64,8 @@ int main(int argc, char* argv[])
 			assert(false);
 	}
 	m_wl->init();
+	// rows inserted by txns are freed on abort, keep them off the regions
+	mem_allocator.close_regions();
 	printf("workload initialized!\n");
 	
 	uint64_t thd_cnt = g_thread_cnt;
@@ -82,6 +90,10 @@ int main(int argc, char* argv[])
 
 	for (uint32_t i = 0; i < thd_cnt; i++) 
 		m_thds[i]->init(i, m_wl);
+#if CC_ALG == BAMBOO && BB_WAITER_BENCH > 0
+	bench_waiters(m_wl, m_thds[0]);
+	return 0;
+#endif
 
 	if (WARMUP > 0){
 		printf("WARMUP start!\n");
@@ -114,6 +126,13 @@ int main(int argc, char* argv[])
 	
 	if (WORKLOAD != TEST) {
 		printf("PASS! SimTime = %ld\n", endtime - starttime);
+		mem_allocator.print_stats();
+#if INDEX_STRUCT == IDX_HASH
+		for (map<string, INDEX *>::iterator it = m_wl->indexes.begin();
+				it != m_wl->indexes.end(); it++)
+			stats.idx_load_factor = max(stats.idx_load_factor,
+				it->second->load_factor());
+#endif
 		if (STATS_ENABLE)
 			stats.print();
 	} else {
@@ -127,3 +146,30 @@ void * f(void * id) {
 	m_thds[tid]->run();
 	return NULL;
 }
+
+#if CC_ALG == BAMBOO && BB_WAITER_BENCH > 0
+// [BB_WAITER_BENCH] the waiter queue of one row on its own. txn i holds
+// ts i + 1, every round queues them in a new random order.
+static void bench_waiters(workload * wl, thread_t * thd) {
+	Row_bamboo * manager = (Row_bamboo *) _mm_malloc(sizeof(Row_bamboo), 64);
+	manager->init(NULL);
+	BBLockEntry * entries[BB_WAITER_BENCH];
+	for (uint32_t i = 0; i < BB_WAITER_BENCH; i++) {
+		txn_man * txn;
+		wl->get_txn_man(txn, thd);
+		txn->set_ts(i + 1);
+		entries[i] = new BBLockEntry(txn, NULL);
+		entries[i]->type = LOCK_EX;
+	}
+	uint64_t insert_time = 0;
+	uint64_t remove_time = 0;
+	for (uint32_t r = 0; r < BB_WAITER_BENCH_ROUNDS; r++) {
+		for (uint32_t i = BB_WAITER_BENCH - 1; i > 0; i--)
+			swap(entries[i], entries[rand() % (i + 1)]);
+		manager->bench_waiters(entries, BB_WAITER_BENCH, insert_time, remove_time);
+	}
+	double op_cnt = (double) BB_WAITER_BENCH * BB_WAITER_BENCH_ROUNDS;
+	printf("[summary] waiter_cnt=%d, waiter_heap=%d, insert_ns=%.2f, remove_ns=%.2f\n",
+		BB_WAITER_BENCH, BB_WAITER_HEAP, insert_time / op_cnt, remove_time / op_cnt);
+}
+#endif
@@ -2,6 +2,18 @@
 #include "row.h"
 #include "txn.h"
 #include "pthread.h"
+#include <deque>
+
+// [EPOCH_RECLAIM] memory the calling thread retired, oldest first
+struct LimboList {
+	std::deque<LimboEntry> entries;
+	// global epoch at the last scan of the slots
+	uint64_t 		scan_epoch;
+	LimboList() : scan_epoch(0) {}
+};
+static LimboList * limbo_lists = NULL;
+static thread_local LimboList * thd_limbo = NULL;
+#define EPOCH_SLOT(i) _epoch_slots[(i) * (CL_SIZE / sizeof(uint64_t))]
 
 void Manager::init() {
 	timestamp = (uint64_t *) _mm_malloc(sizeof(uint64_t), 64);
@@ -10,17 +22,22 @@ void Manager::init() {
 	_min_ts = 0;
 	_epoch = (uint64_t *) _mm_malloc(sizeof(uint64_t), 64);
 	_last_epoch_update_time = (ts_t *) _mm_malloc(sizeof(uint64_t), 64);
-	_epoch = 0;
-	_last_epoch_update_time = 0;
+	*_epoch = 0;
+	*_last_epoch_update_time = 0;
+	_epoch_slot_cnt = g_thread_cnt * CORO_PER_THREAD;
+	_epoch_slots = (uint64_t *) _mm_malloc(CL_SIZE * _epoch_slot_cnt, 64);
+	for (UInt32 i = 0; i < _epoch_slot_cnt; i++)
+		EPOCH_SLOT(i) = UINT64_MAX;
+	limbo_lists = new LimboList [g_thread_cnt];
 	all_ts = (ts_t volatile **) _mm_malloc(sizeof(ts_t *) * g_thread_cnt, 64);
 	for (uint32_t i = 0; i < g_thread_cnt; i++) 
 		all_ts[i] = (ts_t *) _mm_malloc(sizeof(ts_t), 64);
 
-	_all_txns = new txn_man * [g_thread_cnt];
-	for (UInt32 i = 0; i < g_thread_cnt; i++) {
-		*all_ts[i] = UINT64_MAX;
+	_all_txns = new txn_man * [g_thread_cnt * CORO_PER_THREAD];
+	for (UInt32 i = 0; i < g_thread_cnt * CORO_PER_THREAD; i++)
 		_all_txns[i] = NULL;
-	}
+	for (UInt32 i = 0; i < g_thread_cnt; i++)
+		*all_ts[i] = UINT64_MAX;
 	for (UInt32 i = 0; i < BUCKET_CNT; i++)
 		pthread_mutex_init( &mutexes[i], NULL );
 }
@@ -90,9 +107,9 @@ void Manager::add_ts(uint64_t thd_id, ts_t ts) {
 	*all_ts[thd_id] = ts;
 }
 
-void Manager::set_txn_man(txn_man * txn) {
+void Manager::set_txn_man(txn_man * txn, int coro) {
 	int thd_id = txn->get_thd_id();
-	_all_txns[thd_id] = txn;
+	_all_txns[thd_id * CORO_PER_THREAD + coro] = txn;
 }
 
 
@@ -115,8 +132,67 @@ void
 Manager::update_epoch()
 {
 	ts_t time = get_sys_clock();
-	if (time - *_last_epoch_update_time > LOG_BATCH_TIME * 1000 * 1000) {
-		*_epoch = *_epoch + 1;
-		*_last_epoch_update_time = time;
+	ts_t last = *_last_epoch_update_time;
+	// any thread may advance it, the one that moves the update time wins
+	if (time > last + LOG_BATCH_TIME * 1000 * 1000
+		&& ATOM_CAS(*_last_epoch_update_time, last, time))
+		ATOM_ADD(*_epoch, 1);
+}
+
+void
+Manager::register_thread(uint64_t thd_id) {
+	assert(thd_id < g_thread_cnt);
+	thd_limbo = &limbo_lists[thd_id];
+}
+
+void
+Manager::enter_epoch(uint32_t slot) {
+	if (!EPOCH_RECLAIM)
+		return;
+	EPOCH_SLOT(slot) = *_epoch;
+	// the announcement must be visible before the txn reads any pointer
+	__sync_synchronize();
+}
+
+void
+Manager::exit_epoch(uint32_t slot) {
+	if (!EPOCH_RECLAIM)
+		return;
+	COMPILER_BARRIER
+	EPOCH_SLOT(slot) = UINT64_MAX;
+}
+
+void
+Manager::retire(void * ptr, void (*free_fn)(void *)) {
+	if (!EPOCH_RECLAIM || thd_limbo == NULL) {
+		free_fn(ptr);
+		return;
+	}
+	LimboEntry entry = {ptr, free_fn, *_epoch};
+	thd_limbo->entries.push_back(entry);
+}
+
+void
+Manager::reclaim() {
+	LimboList * limbo = thd_limbo;
+	if (!EPOCH_RECLAIM || limbo == NULL || limbo->entries.empty())
+		return;
+	// nothing new can be freed until the epoch moves
+	uint64_t epoch = *_epoch;
+	if (epoch == limbo->scan_epoch)
+		return;
+	limbo->scan_epoch = epoch;
+	// order the unlinks of the retired memory before reading the slots
+	__sync_synchronize();
+	uint64_t min_epoch = epoch;
+	for (UInt32 i = 0; i < _epoch_slot_cnt; i++) {
+		uint64_t e = EPOCH_SLOT(i);
+		if (e < min_epoch)
+			min_epoch = e;
+	}
+	while (!limbo->entries.empty() && limbo->entries.front().epoch < min_epoch) {
+		LimboEntry & entry = limbo->entries.front();
+		entry.free_fn(entry.ptr);
+		limbo->entries.pop_front();
 	}
 }
@@ -5,6 +5,13 @@
 class row_t;
 class txn_man;
 
+// [EPOCH_RECLAIM] memory unlinked while other txns may still hold it
+struct LimboEntry {
+	void * 			ptr;
+	void 			(*free_fn)(void *);
+	uint64_t 		epoch;
+};
+
 class Manager {
 public:
 	void 			init();
@@ -21,11 +28,24 @@ public:
  	void 			lock_row(row_t * row);
 	void 			release_row(row_t * row);
 	
-	txn_man * 		get_txn_man(int thd_id) { return _all_txns[thd_id]; };
-	void 			set_txn_man(txn_man * txn);
+	// one txn_man per coroutine of each thread
+	txn_man * 		get_txn_man(int thd_id, int coro = 0) {
+		return _all_txns[thd_id * CORO_PER_THREAD + coro]; };
+	void 			set_txn_man(txn_man * txn, int coro = 0);
 	
 	uint64_t 		get_epoch() { return *_epoch; };
 	void 	 		update_epoch();
+
+	// [EPOCH_RECLAIM] a txn announces the global epoch in its slot (one per
+	// thread and coroutine) while it runs. memory retired in epoch e is freed
+	// by the retiring thread once every running txn announced a later epoch.
+	// bind the limbo list of thd_id to the calling thread
+	void 			register_thread(uint64_t thd_id);
+	void 			enter_epoch(uint32_t slot);
+	void 			exit_epoch(uint32_t slot);
+	// frees ptr right away if the calling thread is not registered
+	void 			retire(void * ptr, void (*free_fn)(void *));
+	void 			reclaim();
 private:
 	// for SILO
 	volatile uint64_t * _epoch;		
@@ -40,4 +60,7 @@ private:
 	// for MVCC 
 	volatile ts_t	_last_min_ts_time;
 	ts_t			_min_ts;
+	// [EPOCH_RECLAIM] one cache line per slot, UINT64_MAX when idle
+	volatile uint64_t * _epoch_slots;
+	uint32_t 		_epoch_slot_cnt;
 };
@@ -1,22 +1,34 @@
 #include "mem_alloc.h"
 #include "helper.h"
 #include "global.h"
+#include <sys/mman.h>
+#include <errno.h>
+#include <algorithm>
+#if PART_ALLOC
+#include <numa.h>
+#endif
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+// arenas bound to the calling thread by register_thread()
+static thread_local Arena * thd_arenas = NULL;
+// regions the calling thread carves from, one per partition under
+// g_part_alloc and a single one otherwise
+static thread_local char ** region_cur = NULL;
+static thread_local char ** region_end = NULL;
 
 // Assume the data is strided across the L2 slices, stride granularity 
 // is the size of a page
 void mem_alloc::init(uint64_t part_cnt, uint64_t bytes_per_part) {
-	if (g_thread_cnt < g_init_parallelism)
-		_bucket_cnt = g_init_parallelism * 4 + 1;
-	else
-		_bucket_cnt = g_thread_cnt * 4 + 1;
-	pid_arena = new std::pair<pthread_t, int>[_bucket_cnt];
-	for (int i = 0; i < _bucket_cnt; i ++)
-		pid_arena[i] = std::make_pair(0, 0);
-
 	if (THREAD_ALLOC) {
 		assert( !g_part_alloc );
 		init_thread_arena();
 	}
+	_regions_open = (HUGE_PAGE != HP_NONE || g_part_alloc);
+	_hugetlb_failed = false;
+	_region_bytes = 0;
+	pthread_mutex_init(&_region_lock, NULL);
 }
 
 void 
@@ -26,26 +38,36 @@ Arena::init(int arena_id, int size) {
 	_size_in_buffer = 0;
 	_head = NULL;
 	_block_size = size;
+	_alloc_cnt = 0;
+	_free_cnt = 0;
+	_buffer_bytes = 0;
+	_remote_head = NULL;
+	_remote_free_cnt = 0;
 }
 
 void *
 Arena::alloc() {
 	FreeBlock * block;
+	if (_head == NULL && _remote_head != NULL)
+		_head = ATOM_SWAP(_remote_head, (FreeBlock *) NULL);
 	if (_head == NULL) {
 		// not in the list. allocate from the buffer
 		int size = (_block_size + sizeof(FreeBlock) + (MEM_ALLIGN - 1)) & ~(MEM_ALLIGN-1);
 		if (_size_in_buffer < size) {
 			_buffer = (char *) malloc(_block_size * 40960);
 			_size_in_buffer = _block_size * 40960; // * 8;
+			_buffer_bytes += _size_in_buffer;
 		}
 		block = (FreeBlock *)_buffer;
 		block->size = _block_size;
+		block->arena_id = _arena_id;
 		_size_in_buffer -= size;
 		_buffer = _buffer + size;
 	} else {
 		block = _head;
 		_head = _head->next;
 	}
+	_alloc_cnt ++;
 	return (void *) ((char *)block + sizeof(FreeBlock));
 }
 
@@ -54,64 +76,70 @@ Arena::free(void * ptr) {
 	FreeBlock * block = (FreeBlock *)((UInt64)ptr - sizeof(FreeBlock));
 	block->next = _head;
 	_head = block;
+	_free_cnt ++;
+}
+
+void
+Arena::remote_free(void * ptr) {
+	FreeBlock * block = (FreeBlock *)((UInt64)ptr - sizeof(FreeBlock));
+	FreeBlock * head;
+	do {
+		head = _remote_head;
+		block->next = head;
+	} while (!ATOM_CAS(_remote_head, head, block));
+	ATOM_ADD(_remote_free_cnt, 1);
+}
+
+void
+Arena::print_stats() {
+	if (_alloc_cnt == 0 && _remote_free_cnt == 0)
+		return;
+	printf("[arena=%d] block_size=%d, in_use=%ld, remote_free_cnt=%lu, buffer_bytes=%lu\n",
+		_arena_id, _block_size,
+		(int64_t) (_alloc_cnt - _free_cnt - _remote_free_cnt),
+		_remote_free_cnt, _buffer_bytes);
 }
 
 void mem_alloc::init_thread_arena() {
 	UInt32 buf_cnt = g_thread_cnt;
 	if (buf_cnt < g_init_parallelism)
 		buf_cnt = g_init_parallelism;
-	_arenas = new Arena * [buf_cnt];
-	for (UInt32 i = 0; i < buf_cnt; i++) {
+	_arena_cnt = buf_cnt;
+	// the last set is shared by unregistered threads
+	_arenas = new Arena * [buf_cnt + 1];
+	for (UInt32 i = 0; i < buf_cnt + 1; i++) {
 		_arenas[i] = new Arena[SizeNum];
 		for (int n = 0; n < SizeNum; n++) {
 			assert(sizeof(Arena) == 128);
 			_arenas[i][n].init(i, BlockSizes[n]);
 		}
 	}
+	_shared_arenas = _arenas[buf_cnt];
+	pthread_mutex_init(&_shared_lock, NULL);
 }
 
 void mem_alloc::register_thread(int thd_id) {
 	if (THREAD_ALLOC) {
-		pthread_mutex_lock( &map_lock );
-		pthread_t pid = pthread_self();
-		int entry = pid % _bucket_cnt;
-		while (pid_arena[ entry ].first != 0) {
-			printf("conflict at entry %d (pid=%ld)\n", entry, pid);
-			entry = (entry + 1) % _bucket_cnt;
-		}
-		pid_arena[ entry ].first = pid;
-		pid_arena[ entry ].second = thd_id;
-		pthread_mutex_unlock( &map_lock );
+		assert((UInt32) thd_id < _arena_cnt);
+		thd_arenas = _arenas[thd_id];
 	}
 }
 
 void mem_alloc::unregister() {
-	if (THREAD_ALLOC) {
-		pthread_mutex_lock( &map_lock );
-		for (int i = 0; i < _bucket_cnt; i ++) {
-			pid_arena[i].first = 0;
-			pid_arena[i].second = 0;
-		}
-		pthread_mutex_unlock( &map_lock );
-	}
+	thd_arenas = NULL;
 }
 
-int 
-mem_alloc::get_arena_id() {
-	int arena_id; 
-#if NOGRAPHITE
-	pthread_t pid = pthread_self();
-	int entry = pid % _bucket_cnt;
-	while (pid_arena[entry].first != pid) {
-		if (pid_arena[entry].first == 0)
-			break;
-		entry = (entry + 1) % _bucket_cnt;
-	}
-	arena_id = pid_arena[entry].second;
-#else 
-	arena_id = CarbonGetTileId();
-#endif
-	return arena_id;
+void mem_alloc::print_stats() {
+	if (HUGE_PAGE != HP_NONE || g_part_alloc)
+		printf("[region] mapped_bytes=%lu, page=%s\n", _region_bytes,
+			(HUGE_PAGE == HP_NONE)? "4kb" :
+			(HUGE_PAGE == HP_THP || _hugetlb_failed)? "thp" :
+			(HUGE_PAGE == HP_2MB)? "2mb" : "1gb");
+	if (!THREAD_ALLOC)
+		return;
+	for (UInt32 i = 0; i < _arena_cnt + 1; i++)
+		for (int n = 0; n < SizeNum; n++)
+			_arenas[i][n].print_stats();
 }
 
 int 
@@ -129,11 +157,18 @@ mem_alloc::get_size_id(UInt32 size) {
 void mem_alloc::free(void * ptr, uint64_t size) {
 	if (NO_FREE) {} 
 	else if (THREAD_ALLOC) {
-		int arena_id = get_arena_id();
 		FreeBlock * block = (FreeBlock *)((UInt64)ptr - sizeof(FreeBlock));
+		if (block->arena_id == MALLOC_ARENA) {
+			std::free(block);
+			return;
+		}
 		int size = block->size;
 		int size_id = get_size_id(size);
-		_arenas[arena_id][size_id].free(ptr);
+		Arena * owner = _arenas[block->arena_id];
+		if (likely(owner == thd_arenas))
+			owner[size_id].free(ptr);
+		else
+			owner[size_id].remote_free(ptr);
 	} else {
 		std::free(ptr);
 	}
@@ -145,16 +180,105 @@ void mem_alloc::free(void * ptr, uint64_t size) {
 // cause trouble)
 void * mem_alloc::alloc(uint64_t size, uint64_t part_id) {
 	void * ptr;
-    if (size > BlockSizes[SizeNum - 1])
-        ptr = malloc(size);
-	else if (THREAD_ALLOC && (warmup_finish || enable_thread_mem_pool)) {
-		int arena_id = get_arena_id();
-		int size_id = get_size_id(size);
-		ptr = _arenas[arena_id][size_id].alloc();
-	} else {
+	if (!THREAD_ALLOC)
 		ptr = malloc(size);
+	else if (size > BlockSizes[SizeNum - 1]
+			|| !(warmup_finish || enable_thread_mem_pool)) {
+		// free() tells these from arena blocks by the header
+		FreeBlock * block = (FreeBlock *) malloc(size + sizeof(FreeBlock));
+		block->size = size;
+		block->arena_id = MALLOC_ARENA;
+		ptr = (void *) ((char *) block + sizeof(FreeBlock));
+	} else {
+		int size_id = get_size_id(size);
+		Arena * arenas = thd_arenas;
+		if (likely(arenas != NULL))
+			ptr = arenas[size_id].alloc();
+		else {
+			pthread_mutex_lock(&_shared_lock);
+			ptr = _shared_arenas[size_id].alloc();
+			pthread_mutex_unlock(&_shared_lock);
+		}
+	}
+	return ptr;
+}
+
+
+
+void * mem_alloc::alloc_region(uint64_t size, uint64_t part_id) {
+	if (!_regions_open)
+		return NULL;
+	if (region_cur == NULL) {
+		region_cur = new char * [g_part_cnt]();
+		region_end = new char * [g_part_cnt]();
+	}
+	uint64_t slot = g_part_alloc? part_id : 0;
+	size = (size + 63) & ~63UL;
+	if ((uint64_t) (region_end[slot] - region_cur[slot]) < size) {
+		// the tail of the old region is wasted
+		uint64_t unit = (HUGE_PAGE == HP_1GB)? (1UL << 30) : (64UL << 20);
+		uint64_t bytes = (size + unit - 1) / unit * unit;
+		region_cur[slot] = map_region(bytes, part_id);
+		region_end[slot] = region_cur[slot] + bytes;
 	}
+	void * ptr = region_cur[slot];
+	region_cur[slot] += size;
 	return ptr;
 }
 
+void * mem_alloc::alloc_load(uint64_t size, uint64_t part_id) {
+	void * ptr = alloc_region(size, part_id);
+	if (ptr == NULL)
+		ptr = alloc(size, part_id);
+	return ptr;
+}
+
+char * mem_alloc::map_region(uint64_t bytes, uint64_t part_id) {
+	void * ptr = MAP_FAILED;
+	if ((HUGE_PAGE == HP_2MB || HUGE_PAGE == HP_1GB) && !_hugetlb_failed) {
+		int shift = (HUGE_PAGE == HP_1GB)? 30 : 21;
+		ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+		if (ptr == MAP_FAILED && ATOM_CAS(_hugetlb_failed, false, true))
+			printf("[huge] MAP_HUGETLB failed (%s), falling back to THP\n", strerror(errno));
+	}
+	if (ptr == MAP_FAILED) {
+		// map 2MB more so the region starts on a huge page boundary
+		uint64_t page = 1UL << 21;
+		char * raw = (char *) mmap(NULL, bytes + page, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		M_ASSERT(raw != MAP_FAILED, "mmap of %lu bytes failed\n", bytes);
+		ptr = (void *) (((uint64_t) raw + page - 1) & ~(page - 1));
+		if (HUGE_PAGE != HP_NONE)
+			madvise(ptr, bytes, MADV_HUGEPAGE);
+	}
+#if PART_ALLOC
+	// nothing is touched yet, so every page faults in on the partition's node
+	int node = part_to_node(part_id);
+	if (g_part_alloc && node >= 0)
+		numa_tonode_memory(ptr, bytes, node);
+#endif
+	ATOM_ADD(_region_bytes, bytes);
+	pthread_mutex_lock(&_region_lock);
+	_regions.push_back(std::make_pair((char *) ptr, bytes));
+	pthread_mutex_unlock(&_region_lock);
+	return (char *) ptr;
+}
 
+void mem_alloc::close_regions() {
+	_regions_open = false;
+	std::sort(_regions.begin(), _regions.end());
+}
+
+bool mem_alloc::in_region(void * ptr) {
+	assert(!_regions_open);
+	if (_regions.empty())
+		return false;
+	// the last region starting at or before ptr
+	std::vector<std::pair<char *, uint64_t> >::iterator it = std::upper_bound(
+		_regions.begin(), _regions.end(), std::make_pair((char *) ptr, UINT64_MAX));
+	if (it == _regions.begin())
+		return false;
+	--it;
+	return (char *) ptr < it->first + it->second;
+}
@@ -4,11 +4,15 @@
 #include "global.h"
 #include <map>
 
+#define MALLOC_ARENA 		(-1)
+
 const int SizeNum = 4;
 const UInt32 BlockSizes[] = {32, 64, 256, 1024};
 
 typedef struct free_block {
     int size;
+    // arena the block was carved from, MALLOC_ARENA if it came from malloc
+    int arena_id;
     struct free_block* next;
 } FreeBlock;
 
@@ -16,33 +20,69 @@ class Arena {
 public:
 	void init(int arena_id, int size);
 	void * alloc();
+	// only called by the thread owning the arena
 	void free(void * ptr);
+	// called by other threads, the block goes back on the owner's next alloc
+	void remote_free(void * ptr);
+	void print_stats();
 private:
 	char * 		_buffer;
+	FreeBlock * _head;
 	int 		_size_in_buffer;
 	int 		_arena_id;
 	int 		_block_size;
-	FreeBlock * _head;
-	char 		_pad[128 - sizeof(int)*3 - sizeof(void *)*2 - 8];
+	// usage, owner only
+	uint64_t 	_alloc_cnt;
+	uint64_t 	_free_cnt;
+	uint64_t 	_buffer_bytes;
+	char 		_pad[64 - sizeof(void *)*2 - sizeof(int)*4 - sizeof(uint64_t)*3];
+	// blocks freed by other threads, on their own cache line
+	FreeBlock * volatile _remote_head;
+	uint64_t volatile 	_remote_free_cnt;
+	char 		_pad2[64 - sizeof(void *) - sizeof(uint64_t)];
 };
 
 class mem_alloc {
 public:
     void init(uint64_t part_cnt, uint64_t bytes_per_part);
+    // bind the arenas of thd_id to the calling thread
     void register_thread(int thd_id);
+    // unbind the calling thread
     void unregister();
     void * alloc(uint64_t size, uint64_t part_id);
     void free(void * block, uint64_t size);
-	int get_arena_id();
+    // memory that lives until exit, carved from mmap'd regions while the
+    // tables are loaded. the regions are backed by huge pages (HUGE_PAGE)
+    // and bound to the node of part_id (g_part_alloc). NULL if neither is
+    // on or once close_regions() is called.
+    void * alloc_region(uint64_t size, uint64_t part_id);
+    // alloc_region(), or alloc() once loading is done
+    void * alloc_load(uint64_t size, uint64_t part_id);
+    // stop carving regions, later rows come from the regular allocators
+    void close_regions();
+    // region memory is never freed, callers releasing loaded data check this
+    bool in_region(void * ptr);
+    // in_region() may only be asked once this is false
+    bool regions_open() { return _regions_open; }
+    void print_stats();
 private:
     void init_thread_arena();
+    char * map_region(uint64_t bytes, uint64_t part_id);
 	int get_size_id(UInt32 size);
 	
 	// each thread has several arenas for different block size
 	Arena ** _arenas;
-	int _bucket_cnt;
-    std::pair<pthread_t, int>* pid_arena;//                     max_arena_id;
-    pthread_mutex_t         map_lock; // only used for pid_to_arena update
+	UInt32 _arena_cnt;
+	// threads that never registered share these under _shared_lock
+	Arena * _shared_arenas;
+	pthread_mutex_t _shared_lock;
+	// load-time regions
+	volatile bool _regions_open;
+	volatile bool _hugetlb_failed;
+	uint64_t volatile _region_bytes;
+	// start and size of every region, sorted once they are closed
+	std::vector<std::pair<char *, uint64_t> > _regions;
+	pthread_mutex_t _region_lock;
 };
 
 #endif
@@ -38,6 +38,7 @@ void Stats::init() {
   dl_wait_time = 0;
   deadlock = 0;
   cycle_detect = 0;
+  idx_load_factor = 0;
 }
 
 void Stats::init(uint64_t thread_id) {
@@ -106,6 +107,7 @@ void Stats::print() {
       ALL_METRICS(WRITE_STAT_X, WRITE_STAT_Y, WRITE_STAT_Y)
       outf << "deadlock_cnt=" << deadlock << ", ";
       outf << "cycle_detect=" << cycle_detect << ", ";
+      outf << "idx_load_factor=" << idx_load_factor << ", ";
       outf << "dl_detect_time=" << dl_detect_time / BILLION << ", ";
       outf << "dl_wait_time=" << dl_wait_time / BILLION << "\n";
       outf.close();
@@ -116,6 +118,7 @@ void Stats::print() {
   ALL_METRICS(PRINT_STAT_X, PRINT_STAT_Y, PRINT_STAT_Y)
   std::cout << "deadlock_cnt=" << deadlock << ", ";
   std::cout << "cycle_detect=" << cycle_detect << ", ";
+  std::cout << "idx_load_factor=" << idx_load_factor << ", ";
   std::cout << "dl_detect_time=" << dl_detect_time / BILLION << ", ";
   std::cout << "dl_wait_time=" << dl_wait_time / BILLION << "\n";
   if (g_prt_lat_distr)
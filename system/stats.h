@@ -13,6 +13,9 @@
   y(uint64_t, cascading_abort_times) z(uint64_t, max_abort_length) \
   y(uint64_t, txn_cnt_long) y(uint64_t, abort_cnt_long) y(uint64_t, cascading_abort_cnt) \
   y(uint64_t, lock_acquire_cnt) y(uint64_t, lock_directly_cnt) \
+  y(uint64_t, retire_cnt) y(uint64_t, retire_skip_cnt) y(uint64_t, depth_wait_cnt) \
+  y(uint64_t, waiter_len) y(uint64_t, ro_abort_cnt) y(uint64_t, cache_miss_cnt) \
+  y(uint64_t, dtlb_miss_cnt) y(uint64_t, local_access_cnt) y(uint64_t, remote_access_cnt) \
   TMP_METRICS(x, y) 
 #define DECLARE_VAR(tpe, name) tpe name;
 #define INIT_VAR(tpe, name) name = 0;
@@ -68,6 +71,8 @@ class Stats {
   double dl_wait_time;
   uint64_t cycle_detect;
   uint64_t deadlock;
+  // highest keys-per-bucket over the hash indexes at the end of the run
+  double idx_load_factor;
 
   void init();
   void init(uint64_t thread_id);
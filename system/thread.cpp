@@ -1,5 +1,8 @@
 #include <sched.h>
 #include "global.h"
+#if PF_MISS
+#include <linux/perf_event.h>
+#endif
 #include "manager.h"
 #include "thread.h"
 #include "txn.h"
@@ -23,6 +26,10 @@ void thread_t::init(uint64_t thd_id, workload * workload) {
 		_abort_buffer[i].query = NULL;
 	_abort_buffer_empty_slots = _abort_buffer_size;
 	_abort_buffer_enable = (g_params["abort_buffer_enable"] == "true");
+#if CORO_PER_THREAD > 1
+	for (int i = 0; i < CORO_PER_THREAD; i++)
+		_coro_stack[i] = (char *) _mm_malloc(CORO_STACK_SIZE, 64);
+#endif
 }
 
 uint64_t thread_t::get_thd_id() { return _thd_id; }
@@ -38,25 +45,99 @@ RC thread_t::run() {
 	if (warmup_finish) {
 		mem_allocator.register_thread(_thd_id);
 	}
+	glob_manager->register_thread(_thd_id);
 	pthread_barrier_wait( &warmup_bar );
 	stats.init(get_thd_id());
 	pthread_barrier_wait( &warmup_bar );
 
 	set_affinity(get_thd_id());
+#if PF_MISS
+	int miss_fd = perf_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	int tlb_fd = perf_counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+	RC rc;
 
 	myrand rdm;
 	rdm.init(get_thd_id());
-	RC rc = RCOK;
+	_thd_txn_id = 0;
+	_txn_cnt = 0;
+#if CORO_PER_THREAD > 1
+	// run the txns round-robin until all of them return
+	uint64_t self = (uint64_t) this;
+	for (int i = 0; i < CORO_PER_THREAD; i++) {
+		getcontext(&_coro_ctx[i]);
+		_coro_ctx[i].uc_stack.ss_sp = _coro_stack[i];
+		_coro_ctx[i].uc_stack.ss_size = CORO_STACK_SIZE;
+		_coro_ctx[i].uc_link = &_sched_ctx;
+		makecontext(&_coro_ctx[i], (void (*)()) coro_main, 2,
+					(uint32_t) (self >> 32), (uint32_t) self);
+		_coro_done[i] = false;
+	}
+	int live = CORO_PER_THREAD;
+	while (live > 0) {
+		bool idle = true;
+		for (_coro_cur = 0; _coro_cur < CORO_PER_THREAD; _coro_cur++) {
+			if (_coro_done[_coro_cur])
+				continue;
+			_coro_waiting = false;
+			swapcontext(&_sched_ctx, &_coro_ctx[_coro_cur]);
+			if (!_coro_waiting)
+				idle = false;
+			if (_coro_done[_coro_cur])
+				live--;
+		}
+		// every txn waits on other threads, give the core away
+		if (idle)
+			sched_yield();
+	}
+	rc = _coro_rc;
+#else
 	txn_man * m_txn;
 	// get txn man from workload
 	rc = _wl->get_txn_man(m_txn, this);
 	assert (rc == RCOK);
 	glob_manager->set_txn_man(m_txn);
+	rc = run_txns(m_txn);
+#endif
+#if PF_MISS
+	uint64_t miss_cnt = perf_counter_close(miss_fd);
+	uint64_t tlb_cnt = perf_counter_close(tlb_fd);
+	if (warmup_finish) {
+		INC_STATS(get_thd_id(), cache_miss_cnt, miss_cnt);
+		INC_STATS(get_thd_id(), dtlb_miss_cnt, tlb_cnt);
+	}
+#endif
+	return rc;
+}
+
+#if CORO_PER_THREAD > 1
+void thread_t::coro_main(uint32_t hi, uint32_t lo) {
+	thread_t * thd = (thread_t *) (((uint64_t) hi << 32) | lo);
+	txn_man * m_txn;
+	RC rc = thd->_wl->get_txn_man(m_txn, thd);
+	assert (rc == RCOK);
+	glob_manager->set_txn_man(m_txn, thd->_coro_cur);
+	thd->_coro_rc = thd->run_txns(m_txn);
+	thd->_coro_done[thd->_coro_cur] = true;
+	// returns to _sched_ctx through uc_link
+}
+
+void thread_t::yield() {
+	_coro_waiting = true;
+	swapcontext(&_coro_ctx[_coro_cur], &_sched_ctx);
+}
+#endif
 
+RC thread_t::run_txns(txn_man * m_txn) {
+	RC rc = RCOK;
 	base_query * m_query = NULL;
-	uint64_t thd_txn_id = 0;
-	UInt64 txn_cnt = 0;
 	ts_t txn_starttime = 0;
+#if CORO_PER_THREAD > 1
+	uint32_t epoch_slot = get_thd_id() * CORO_PER_THREAD + _coro_cur;
+#else
+	uint32_t epoch_slot = get_thd_id();
+#endif
 
 	while (true) {
 		ts_t starttime = get_sys_clock();
@@ -123,8 +204,8 @@ RC thread_t::run() {
         if (unlikely(m_txn->get_ts() == 0))
             m_txn->set_ts(get_next_ts());
 #endif
-		m_txn->set_txn_id(get_thd_id() + thd_txn_id * g_thread_cnt);
-		thd_txn_id ++;
+		m_txn->set_txn_id(get_thd_id() + _thd_txn_id * g_thread_cnt);
+		_thd_txn_id ++;
 
 		if ((CC_ALG == HSTORE && !HSTORE_LOCAL_TS)
 			|| CC_ALG == MVCC
@@ -133,6 +214,7 @@ RC thread_t::run() {
 			m_txn->set_ts(get_next_ts());
 
 		rc = RCOK;
+		glob_manager->enter_epoch(epoch_slot);
 #if CC_ALG == HSTORE
 		if (WORKLOAD == TEST) {
 			uint64_t part_to_access[1] = {0};
@@ -168,6 +250,9 @@ RC thread_t::run() {
 		}
 
 		ts_t endtime = get_sys_clock();
+		glob_manager->exit_epoch(epoch_slot);
+		glob_manager->update_epoch();
+		glob_manager->reclaim();
 
 		if (rc == Abort) {
 			uint64_t penalty = 0;
@@ -206,7 +291,7 @@ RC thread_t::run() {
             }
 #endif
 			stats.commit(get_thd_id());
-			txn_cnt ++;
+			_txn_cnt ++;
 		} else if (rc == Abort) {
 			INC_STATS(get_thd_id(), time_abort, timespan);
 			INC_STATS(get_thd_id(), abort_cnt, 1);
@@ -235,19 +320,28 @@ RC thread_t::run() {
 
 		if (rc == FINISH) {
 #if CC_ALG == IC3
-		    m_txn->set_txn_id(get_thd_id() + thd_txn_id * g_thread_cnt);
+		    m_txn->set_txn_id(get_thd_id() + _thd_txn_id * g_thread_cnt);
 #endif
 			return rc;
 		}
-		if (!warmup_finish && txn_cnt >= WARMUP / g_thread_cnt)
+#if CORO_PER_THREAD > 1
+		// rerun an aborted query before returning, the other txns of the
+		// thread need its abort buffer slot. the query stays buffered for
+		// the next run if this one is over.
+		if (rc == Abort && !_wl->sim_done &&
+			(warmup_finish || _txn_cnt < WARMUP / g_thread_cnt))
+			continue;
+#endif
+		if (!warmup_finish && _txn_cnt >= WARMUP / g_thread_cnt)
 		{
 			stats.clear( get_thd_id() );
 			return FINISH;
 		}
 
 #if TERMINATE_BY_COUNT
-		if (warmup_finish && txn_cnt >= MAX_TXN_PER_PART) {
-			assert(txn_cnt == MAX_TXN_PER_PART);
+		if (warmup_finish && _txn_cnt >= MAX_TXN_PER_PART) {
+			// other txns of the thread may commit before they see sim_done
+			assert(CORO_PER_THREAD > 1 || _txn_cnt == MAX_TXN_PER_PART);
 			if( !ATOM_CAS(_wl->sim_done, false, true) )
 				assert( _wl->sim_done);
 		}
@@ -261,7 +355,7 @@ RC thread_t::run() {
 
 		if (_wl->sim_done) {
 #if CC_ALG == IC3
-		    m_txn->set_txn_id(get_thd_id() + thd_txn_id * g_thread_cnt);
+		    m_txn->set_txn_id(get_thd_id() + _thd_txn_id * g_thread_cnt);
 #endif
 			return FINISH;
 		}
@@ -1,6 +1,15 @@
 #pragma once
 
 #include "global.h"
+#if CORO_PER_THREAD > 1
+#include <ucontext.h>
+#if CC_ALG != WOUND_WAIT && CC_ALG != BAMBOO
+#error "CORO_PER_THREAD only yields at WOUND_WAIT and BAMBOO waits"
+#endif
+#if LATCH == LH_LOCKFREE
+#error "LH_LOCKFREE keeps one reader bit per thread, not per txn"
+#endif
+#endif
 
 class workload;
 class base_query;
@@ -27,6 +36,10 @@ class thread_t {
     // moved from private to global for clv
     ts_t 		get_next_ts();
     ts_t 		get_next_n_ts(int n);
+#if CORO_PER_THREAD > 1
+    // switch to the next txn of this thread
+    void 		yield();
+#endif
 
 
   private:
@@ -35,6 +48,21 @@ class thread_t {
     ts_t 		_curr_ts;
 
     RC	 		runTest(txn_man * txn);
+    RC 			run_txns(txn_man * m_txn);
+    // shared by all txns of the thread
+    uint64_t 	_thd_txn_id;
+    UInt64 		_txn_cnt;
+#if CORO_PER_THREAD > 1
+    // makecontext() only passes ints, this is split in two
+    static void coro_main(uint32_t hi, uint32_t lo);
+    ucontext_t 	_sched_ctx;
+    ucontext_t 	_coro_ctx[CORO_PER_THREAD];
+    char * 		_coro_stack[CORO_PER_THREAD];
+    bool 		_coro_done[CORO_PER_THREAD];
+    int 		_coro_cur;
+    bool 		_coro_waiting; // _coro_cur returned through yield()
+    RC 			_coro_rc;
+#endif
     drand48_data buffer;
 
     // added for wound wait
@@ -4,11 +4,13 @@
 #include "ycsb.h"
 #include "thread.h"
 #include "mem_alloc.h"
+#include "manager.h"
 #include "occ.h"
 #include "table.h"
 #include "catalog.h"
 #include "index_btree.h"
 #include "index_hash.h"
+#include "index_simd.h"
 // for info of lock entry
 #include "row_lock.h"
 #include "row_bamboo.h"
@@ -24,6 +26,13 @@ void txn_man::init(thread_t * h_thd, workload * h_wl, uint64_t thd_id) {
 #endif
 #if CC_ALG == BAMBOO
     commit_barriers = 0;
+#if CORO_PER_THREAD > 1
+    wound_marked = false;
+#endif
+#if BB_SPIN_PARK
+    wake_seq = 0;
+    parked = false;
+#endif
     //commit_barriers = g_thread_cnt << 2;
     //tmp_barriers = 0;
     //addr_barriers = &(tmp_barriers);
@@ -37,6 +46,15 @@ void txn_man::init(thread_t * h_thd, workload * h_wl, uint64_t thd_id) {
     for (int i = 0; i < MAX_ROW_PER_TXN; i++)
         accesses[i] = NULL;
     num_accesses_alloc = 0;
+#if CC_ALG == BAMBOO
+    access_slab = (Access *) _mm_malloc(sizeof(Access) * MAX_ROW_PER_TXN, 64);
+    entry_slab = (BBLockEntry *) _mm_malloc(sizeof(BBLockEntry) *
+        MAX_ROW_PER_TXN, 64);
+    row_slab = (row_t *) _mm_malloc(sizeof(row_t) * 2 * MAX_ROW_PER_TXN, 64);
+    row_buf_head = new_row_buf_chunk(BB_ROW_BUF_CHUNK);
+    row_buf = row_buf_head;
+    row_buf_used = 0;
+#endif
 #if CC_ALG == TICTOC || CC_ALG == SILO
     _pre_abort = (g_params["pre_abort"] == "true");
     if (g_params["validation_lock"] == "no-wait")
@@ -67,11 +85,28 @@ void txn_man::set_txn_id(txnid_t txn_id) {
     lock_ready = false;
     status = RUNNING;
 #if CC_ALG == BAMBOO
+#if CORO_PER_THREAD > 1
+    // the accesses are reused below, wait for whoever wounded the last txn
+    // to be done with them
+    while ((commit_barriers & 3UL) == ABORTED && !wound_marked)
+        PAUSE
+    wound_marked = false;
+#endif
     commit_barriers = 0;
+#if BB_MAX_DEPTH > 0
+    dep_depth = 0;
+#endif
     //commit_barriers = g_thread_cnt << 2;
     //addr_barriers = &(tmp_barriers);
     if (g_last_retire > 0)
         start_ts = get_sys_clock();
+#if BB_AUTORETIRE
+    // workloads may lower it to hold the last writes until commit
+    retire_threshold = MAX_ROW_PER_TXN;
+#endif
+#if BB_RO_FASTPATH
+    read_only = false;
+#endif
 #endif
 #endif
 #if CC_ALG == IC3
@@ -143,11 +178,13 @@ void txn_man::cleanup(RC rc) {
         row_t * orig_r = accesses[rid]->orig_row;
         access_t type = accesses[rid]->type;
 #if COMMUTATIVE_OPS
-        if (accesses[rid]->com_op != COM_NONE && (rc != Abort)) {
-      if (accesses[rid]->com_op == COM_INC)
-        orig_r->inc_value(accesses[rid]->com_col, accesses[rid]->com_val);
-      else
-        orig_r->dec_value(accesses[rid]->com_col, accesses[rid]->com_val);
+        if (accesses[rid]->com_op != COM_NONE) {
+      if (rc != Abort) {
+        if (accesses[rid]->com_op == COM_INC)
+          orig_r->inc_value(accesses[rid]->com_col, accesses[rid]->com_val);
+        else
+          orig_r->dec_value(accesses[rid]->com_col, accesses[rid]->com_val);
+      }
       accesses[rid]->com_op = COM_NONE;
     }
 #endif
@@ -160,9 +197,6 @@ void txn_man::cleanup(RC rc) {
         }
 #endif
 
-#if COMMUTATIVE_OPS && !COMMUTATIVE_LATCH
-        if (type != CM) {
-#endif
 #if CC_ALG == BAMBOO
             orig_r->return_row(accesses[rid]->lock_entry, rc);
             accesses[rid]->orig_row = NULL;
@@ -178,9 +212,6 @@ void txn_man::cleanup(RC rc) {
 #else
             orig_r->return_row(type, this, accesses[rid]->data);
 #endif
-#if COMMUTATIVE_OPS && !COMMUTATIVE_LATCH
-        }
-#endif
 
 #if CC_ALG != TICTOC && (CC_ALG != SILO) && (CC_ALG != WOUND_WAIT) && (CC_ALG!= BAMBOO)
         // invalidate ptr for cc keeping globally visible ptr
@@ -189,20 +220,19 @@ void txn_man::cleanup(RC rc) {
     }
 
     if (rc == Abort) {
-        for (UInt32 i = 0; i < insert_cnt; i ++) {
-            row_t * row = insert_rows[i];
-            assert(g_part_alloc == false);
-#if CC_ALG != HSTORE && CC_ALG != OCC
-            mem_allocator.free(row->manager, 0);
-#endif
-            row->free_row();
-            mem_allocator.free(row, sizeof(row));
-        }
+        // other txns may still hold the rows, e.g. in a retired list
+        for (UInt32 i = 0; i < insert_cnt; i ++)
+            glob_manager->retire(insert_rows[i], row_t::reclaim);
     }
 
     row_cnt = 0;
     wr_cnt = 0;
     insert_cnt = 0;
+#if CC_ALG == BAMBOO
+    // all lock entries are released, no one reads the local copies anymore
+    row_buf = row_buf_head;
+    row_buf_used = 0;
+#endif
 #if CC_ALG == DL_DETECT
     dl_detector.clear_dep(get_txn_id());
 #endif
@@ -213,7 +243,7 @@ void txn_man::cleanup(RC rc) {
 inline
 void txn_man::assign_lock_entry(Access * access) {
 #if CC_ALG == BAMBOO
-    auto lock_entry = (BBLockEntry *) _mm_malloc(sizeof(BBLockEntry), 64);
+    auto lock_entry = &entry_slab[access - access_slab];
     new (lock_entry) BBLockEntry(this, access);
 #else
     auto lock_entry = (LockEntry *) _mm_malloc(sizeof(LockEntry), 64);
@@ -225,17 +255,80 @@ void txn_man::assign_lock_entry(Access * access) {
 }
 #endif
 
-row_t * txn_man::get_row(row_t * row, access_t type) {
+#if CC_ALG == BAMBOO && CORO_PER_THREAD > 1
+// called once, by whoever wounds this txn. its retired writes stay in the
+// lists until its coroutine runs again, tell their rows in the meantime.
+void txn_man::mark_wounded_writes() {
+    for (int rid = 0; rid < row_cnt; rid++) {
+        Access * access = accesses[rid];
+        BBLockEntry * en = access->lock_entry;
+        if (en->type == LOCK_EX && en->status == LOCK_RETIRED)
+            access->orig_row->get_manager(access)->wound_retired(en);
+    }
+    wound_marked = true;
+}
+#endif
+
+#if CC_ALG == BAMBOO
+char * txn_man::alloc_row_buf(uint64_t size, uint64_t align) {
+    uint64_t bytes = (size + align - 1) & ~(align - 1);
+    if (unlikely(row_buf_used + bytes > row_buf->size)) {
+        // move on to the next chunk, chain a new one if it is too small
+        if (row_buf->next == NULL || row_buf->next->size < bytes) {
+            RowBufChunk * chunk = new_row_buf_chunk(
+                bytes > BB_ROW_BUF_CHUNK ? bytes : BB_ROW_BUF_CHUNK);
+            chunk->next = row_buf->next;
+            row_buf->next = chunk;
+        }
+        row_buf = row_buf->next;
+        row_buf_used = 0;
+    }
+    char * buf = row_buf->data() + row_buf_used;
+    row_buf_used += bytes;
+    return buf;
+}
+
+RowBufChunk * txn_man::new_row_buf_chunk(uint64_t size) {
+    RowBufChunk * chunk = (RowBufChunk *) _mm_malloc(CL_SIZE + size, CL_SIZE);
+    if (chunk == NULL) {
+        printf("out of memory for %lu bytes of tuple buffers\n", size);
+        exit(1);
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    return chunk;
+}
+#endif
+
+row_t * txn_man::get_row(row_t * row, access_t type, int fid) {
     if (CC_ALG == HSTORE)
         return row;
     uint64_t starttime = get_sys_clock();
     RC rc = RCOK;
+#if PART_ALLOC
+    if (g_part_alloc && thread_node() >= 0) {
+        if (part_to_node(row->get_part_id()) == thread_node()) {
+            INC_STATS(get_thd_id(), local_access_cnt, 1);
+        } else {
+            INC_STATS(get_thd_id(), remote_access_cnt, 1);
+        }
+    }
+#endif
+#if CC_ALG == BAMBOO && BB_AUTORETIRE && (THREAD_CNT != 1)
+    // a txn only writes to the local copy of its latest access, so the
+    // previous write is complete once it asks for another row
+    if (row_cnt > 0 && row_cnt - 1 <= retire_threshold &&
+        accesses[row_cnt - 1]->type == WR) {
+        if (retire_row(row_cnt - 1) == Abort)
+            return NULL;
+    }
+#endif
     if (accesses[row_cnt] == NULL) {
         assert(row_cnt < MAX_ROW_PER_TXN);
+#if CC_ALG == BAMBOO
+        Access *access = &access_slab[row_cnt];
+#else
         Access *access = (Access *) _mm_malloc(sizeof(Access), 64);
-#if COMMUTATIVE_OPS
-        // init
-    access->com_op = COM_NONE;
 #endif
         accesses[row_cnt] = access;
 #if (CC_ALG == SILO || CC_ALG == TICTOC)
@@ -261,13 +354,13 @@ row_t * txn_man::get_row(row_t * row, access_t type) {
     // allocate lock entry as well
     assign_lock_entry(access);
     // data is for making local changes before added to retired
-    access->data = (row_t *) _mm_malloc(sizeof(row_t), 64);
-    access->data->init(MAX_TUPLE_SIZE);
-    access->data->table = row->get_table();
+    access->data = &row_slab[2 * row_cnt];
+    // writes to the local copy are tracked so that only dirty columns are
+    // copied back
+    access->data->txn_access = access;
     // orig data is for rollback
-    access->orig_data = (row_t *) _mm_malloc(sizeof(row_t), 64);
-    access->orig_data->init(MAX_TUPLE_SIZE);
-    access->orig_data->table = row->get_table();
+    access->orig_data = &row_slab[2 * row_cnt + 1];
+    access->orig_data->txn_access = NULL;
 #elif (CC_ALG == DL_DETECT || (CC_ALG == NO_WAIT) || (CC_ALG == WAIT_DIE))
     // allocate lock entry as well
     assign_lock_entry(access);
@@ -276,6 +369,29 @@ row_t * txn_man::get_row(row_t * row, access_t type) {
 #endif
         num_accesses_alloc++;
     }
+#if COMMUTATIVE_OPS
+    // slots are reused, an aborted increment must not carry over
+    accesses[row_cnt]->com_op = COM_NONE;
+#endif
+#if CC_ALG == BAMBOO
+    // tuple buffers for this access, sized for the table
+    accesses[row_cnt]->data->data = alloc_row_buf(row->get_tuple_size());
+    accesses[row_cnt]->data->table = row->get_table();
+#if BB_UNDO_LOG
+    accesses[row_cnt]->orig_data->data = NULL;
+#else
+    if (type == WR) {
+        accesses[row_cnt]->orig_data->data =
+            alloc_row_buf(row->get_tuple_size());
+        accesses[row_cnt]->orig_data->table = row->get_table();
+    } else {
+        accesses[row_cnt]->orig_data->data = NULL;
+    }
+#endif
+#if BB_FIELD_LOCKING
+    accesses[row_cnt]->fid = fid;
+#endif
+#endif
     //printf("txn-%lu access(%p) row %p at access[%d]\n", txn_id, accesses[row_cnt], row , row_cnt);
 #if (CC_ALG == WOUND_WAIT) || (CC_ALG == BAMBOO)
     rc = row->get_row(type, this, accesses[ row_cnt ]->orig_row,
@@ -336,9 +452,16 @@ row_t * txn_man::get_row(row_t * row, access_t type) {
         // make local copy to work on
     accesses[row_cnt]->data->table = row->get_table();
     accesses[row_cnt]->data->copy(row);
+    accesses[row_cnt]->dirty_fields = 0;
+#if BB_UNDO_LOG
+    // before-images are logged by set_value()
+    accesses[row_cnt]->undo = NULL;
+    accesses[row_cnt]->undo_fields = 0;
+#else
     // make copy to rollback
     accesses[row_cnt]->orig_data->table = row->get_table();
     accesses[row_cnt]->orig_data->copy(row);
+#endif
 #elif ROLL_BACK && (CC_ALG == DL_DETECT || CC_ALG == NO_WAIT || CC_ALG == WAIT_DIE)
     accesses[row_cnt]->orig_data->table = row->get_table();
     accesses[row_cnt]->orig_data->copy(row);
@@ -418,6 +541,14 @@ txn_man::index_read(INDEX * index, idx_key_t key, int part_id, itemid_t *& item)
     INC_TMP_STATS(get_thd_id(), time_index, get_sys_clock() - starttime);
 }
 
+void
+txn_man::index_read_batch(INDEX * index, idx_key_t * keys, int * part_ids,
+                          uint32_t cnt, itemid_t ** items) {
+    uint64_t starttime = get_sys_clock();
+    index->index_read_batch(keys, part_ids, cnt, items, get_thd_id());
+    INC_TMP_STATS(get_thd_id(), time_index, get_sys_clock() - starttime);
+}
+
 RC txn_man::finish(RC rc) {
 #if TPCC_USER_ABORT
     RC ret_rc = rc;
@@ -472,10 +603,21 @@ RC txn_man::finish(RC rc) {
 	}
 	cleanup(rc);
 #elif CC_ALG == BAMBOO
+#if BB_RO_FASTPATH
+  if (rc != Abort && read_only) {
+      rc = validate_read_only();
+      if (rc == Abort)
+          INC_STATS(get_thd_id(), ro_abort_cnt, 1);
+  }
+#endif
   if (rc == Abort)
       status = ABORTED;
   else {
     uint64_t starttime = get_sys_clock();
+#if BB_SPIN_PARK
+    uint64_t spins = 0;
+    uint32_t seq = wake_seq;
+#endif
     //int times = 0;
     // aggregate barrier
     // addr_barriers = &(commit_barriers);
@@ -505,6 +647,11 @@ RC txn_man::finish(RC rc) {
            //     times = 0;
            // }
         }
+#if CORO_PER_THREAD > 1
+        h_thd->yield();
+#elif BB_SPIN_PARK
+        spin_or_park(spins, seq);
+#endif
     }
 #if PF_BASIC 
     INC_STATS(get_thd_id(), time_commit, get_sys_clock() - starttime);
@@ -529,18 +676,31 @@ RC txn_man::finish(RC rc) {
 
 void
 txn_man::release() {
+#if CC_ALG == BAMBOO
+    _mm_free(access_slab);
+    _mm_free(entry_slab);
+    _mm_free(row_slab);
+    while (row_buf_head) {
+        RowBufChunk * next = row_buf_head->next;
+        _mm_free(row_buf_head);
+        row_buf_head = next;
+    }
+#else
     for (int i = 0; i < num_accesses_alloc; i++) {
-    #if CC_ALG == BAMOO || CC_ALG == NO_WAIT || CC_ALG == WOUND_WAIT || CC_ALG == WAIT_DIE || CC_ALG == DL_DETEC
-        delete accesses[i]->lock_entry;
+    #if CC_ALG == NO_WAIT || CC_ALG == WOUND_WAIT || CC_ALG == WAIT_DIE || CC_ALG == DL_DETECT
+        _mm_free(accesses[i]->lock_entry);
     #endif
-        mem_allocator.free(accesses[i], 0);
+        _mm_free(accesses[i]);
     }
-    mem_allocator.free(accesses, 0);
+#endif
+    _mm_free(accesses);
+#if LATCH == LH_MCSLOCK
     delete mcs_node;
+#endif
 }
 
 #if COMMUTATIVE_OPS
-void txn_man::inc_value(int col, uint64_t val) {
+void txn_man::inc_value(int col, double val) {
   // store operation and execute at commit time
   Access * access = accesses[row_cnt-1];
   access->com_op = COM_INC;
@@ -548,7 +708,7 @@ void txn_man::inc_value(int col, uint64_t val) {
   access->com_col = col;
 }
 
-void txn_man::dec_value(int col, uint64_t val) {
+void txn_man::dec_value(int col, double val) {
   // store operation and execute at commit time
   Access * access = accesses[row_cnt-1];
   access->com_op = COM_DEC;
@@ -21,6 +21,23 @@ struct BBLockEntry;
 //For VLL
 enum TxnType {VLL_Blocked, VLL_Free};
 
+#if CC_ALG == BAMBOO
+// a chunk of tuple buffers, the buffers start one cache line in
+struct RowBufChunk {
+    RowBufChunk *   next;
+    uint64_t        size; // bytes available for buffers
+    char *          data() { return (char *) this + CL_SIZE; };
+};
+#endif
+
+#if CC_ALG == BAMBOO && BB_UNDO_LOG
+// before-image of a column, followed by the column's bytes
+struct UndoRec {
+    UndoRec *   prev; // earlier record of the same access
+    int         fid;
+};
+#endif
+
 class Access {
   public:
     access_t 	type;
@@ -29,6 +46,18 @@ class Access {
     row_t * 	orig_data;
 #if CC_ALG == BAMBOO
     BBLockEntry * lock_entry;
+    // columns written to data, set through row_t::set_value()
+    uint64_t    dirty_fields;
+#if BB_FIELD_LOCKING
+    int         fid; // column locked by this access, -1 for the whole tuple
+#endif
+#if BB_RO_FASTPATH
+    uint64_t    snapshot_ver; // committed writes to the row when copied
+#endif
+#if BB_UNDO_LOG
+    UndoRec *   undo;         // latest before-image, replaces orig_data
+    uint64_t    undo_fields;  // columns below 64 already logged
+#endif
 #elif CC_ALG == WOUND_WAIT || CC_ALG == WAIT_DIE || CC_ALG == NO_WAIT || CC_ALG == DL_DETECT
     LockEntry * lock_entry;
 #elif CC_ALG == TICTOC
@@ -48,8 +77,8 @@ class Access {
     uint64_t  lk_accesses;
 #endif
 #if COMMUTATIVE_OPS
-    // support increment-only for now
-    uint64_t  com_val;
+    // support increment-only of double columns for now
+    double    com_val;
     int       com_col;
     com_t     com_op;
 #endif
@@ -114,8 +143,29 @@ class txn_man
     // low 2 bits representing status 
     uint64_t volatile   commit_barriers;
     uint8_t             padding2[64 - sizeof(uint64_t)];
+#if CC_ALG == BAMBOO && BB_MAX_DEPTH > 0
+    // length of the chain of uncommitted writes this txn depends on
+    UInt32 volatile     dep_depth;
+#endif
+#if CC_ALG == BAMBOO && BB_RO_FASTPATH
+    // set by the workload before the first access
+    bool                read_only;
+#endif
+#if CC_ALG == BAMBOO && CORO_PER_THREAD > 1
+    // the wounder has counted this txn's retired writes on their rows
+    bool volatile       wound_marked;
+#endif
+#if CC_ALG == BAMBOO && BB_SPIN_PARK
+    // futex word, bumped by every wakeup()
+    uint32_t volatile   wake_seq;
+    bool volatile       parked;
+#endif
     //uint64_t volatile   tmp_barriers;
     //volatile uint64_t * volatile addr_barriers;
+    // accesses up to this index may retire their writes before commit.
+    // with BB_AUTORETIRE, get_row() retires the previous write when the next
+    // row is requested, so a txn must finish writing a row before it asks
+    // for another one; set_value() asserts it.
     int                 retire_threshold;
 
     // [BAMBOO-AUTORETIRE, OCC]
@@ -126,6 +176,18 @@ class txn_man
     int	 		        wr_cnt;
     Access **		    accesses;
     int 			    num_accesses_alloc;
+#if CC_ALG == BAMBOO
+    // per-thread slab allocated in init(). access i lives in access_slab[i]
+    // and entry_slab[i], its local copies in row_slab[2i] and row_slab[2i+1].
+    // tuple buffers are carved from the row_buf chunks for each txn, sized
+    // by table. the chain grows to fit the largest txn and is kept.
+    Access *            access_slab;
+    BBLockEntry *       entry_slab;
+    row_t *             row_slab;
+    RowBufChunk *       row_buf_head;
+    RowBufChunk *       row_buf;
+    uint64_t            row_buf_used;
+#endif
     // [TIMESTAMP, MVCC]
     bool volatile       ts_ready;
     // [HSTORE]
@@ -187,8 +249,8 @@ class txn_man
 
     // [COMMUTATIVE OPERATIONS]
 #if COMMUTATIVE_OPS
-    void                inc_value(int col, uint64_t val);
-    void                dec_value(int col, uint64_t val);
+    void                inc_value(int col, double val);
+    void                dec_value(int col, double val);
 #endif
     // [WW, BAMBOO]
     // if already abort, no change, return aborted
@@ -203,7 +265,12 @@ class txn_man
         // (1) what if two txns both atomic add? may change from abort to commit
         // (2) moreover, may exceed two bits
         while (s == RUNNING) {
+#if CORO_PER_THREAD > 1
+            if (ATOM_CAS(commit_barriers, local, (barriers << 2) + ABORTED))
+                mark_wounded_writes();
+#else
             ATOM_CAS(commit_barriers, local, (barriers << 2) + ABORTED);
+#endif
             local = commit_barriers;
             barriers = local >> 2;
             s = local & 3UL;
@@ -211,6 +278,9 @@ class txn_man
         if (s == ABORTED) {
             if (!lock_abort)
                 lock_abort = true;
+#if CC_ALG == BAMBOO && BB_SPIN_PARK
+            wakeup();
+#endif
 #if PF_MODEL
             if (cascading)
                 INC_STATS(get_thd_id(), cascading_abort_cnt, 1);
@@ -233,8 +303,17 @@ class txn_man
 #endif
     };
     status_t            wound_txn(txn_man * txn);
+#if CC_ALG == BAMBOO && CORO_PER_THREAD > 1
+    void                mark_wounded_writes();
+#endif
     void                increment_commit_barriers();
     void                decrement_commit_barriers();
+#if CC_ALG == BAMBOO && BB_SPIN_PARK
+    // one round of a wait loop. seq is read before the wait condition, so a
+    // wakeup() after the check is never lost.
+    void                spin_or_park(uint64_t & spins, uint32_t & seq);
+    void                wakeup();
+#endif
     // dynamically set timestamp
     bool                atomic_set_ts(ts_t ts);
     ts_t			    set_next_ts(int n);
@@ -242,12 +321,23 @@ class txn_man
     ts_t                get_exec_time() {return get_sys_clock() - start_ts;};
 #if CC_ALG == BAMBOO
     RC                  retire_row(int access_cnt);
+#if BB_RO_FASTPATH
+    RC                  validate_read_only();
+#endif
+#if BB_UNDO_LOG
+    void                log_undo(Access * access, int fid);
+#endif
 #endif
     // [VLL]
-    row_t * 		    get_row(row_t * row, access_t type);
+    // fid: column to lock when the table is locked at field granularity
+    row_t * 		    get_row(row_t * row, access_t type, int fid = -1);
     itemid_t *	        index_read(INDEX * index, idx_key_t key, int part_id);
     void 			    index_read(INDEX * index, idx_key_t key, int part_id,
                                    itemid_t *& item);
+    // items[i] is the item of keys[i] in partition part_ids[i]
+    void 			    index_read_batch(INDEX * index, idx_key_t * keys,
+                                         int * part_ids, uint32_t cnt,
+                                         itemid_t ** items);
     // [IC3]
     void                begin_piece(int piece_id);
     RC                  end_piece(int piece_id);
@@ -276,6 +366,10 @@ class txn_man
 #if CC_ALG == BAMBOO || CC_ALG == WOUND_WAIT || CC_ALG == WAIT_DIE || CC_ALG == NO_WAIT || CC_ALG == DL_DETECT
     void                assign_lock_entry(Access * access);
 #endif
+#if CC_ALG == BAMBOO
+    char *              alloc_row_buf(uint64_t size, uint64_t align = 64);
+    static RowBufChunk * new_row_buf_chunk(uint64_t size);
+#endif
 
 };
 
@@ -4,6 +4,7 @@
 #include "row.h"
 #include "table.h"
 #include "index_hash.h"
+#include "index_simd.h"
 #include "index_btree.h"
 #include "catalog.h"
 #include "mem_alloc.h"
@@ -85,7 +86,7 @@ RC workload::init_schema(string schema_file) {
 			int part_cnt = (CENTRAL_INDEX)? 1 : g_part_cnt;
 			if (tname == "ITEM")
 				part_cnt = 1;
-#if INDEX_STRUCT == IDX_HASH
+#if INDEX_STRUCT == IDX_HASH || INDEX_STRUCT == IDX_SIMD
 	#if WORKLOAD == YCSB
 			index->init(part_cnt, tables[tname], g_synth_table_size * 2);
 	#elif WORKLOAD == TPCC
@@ -115,7 +116,7 @@ void workload::index_insert(INDEX * index, uint64_t key, row_t * row, int64_t pa
 	if (part_id == -1)
 		pid = get_part_id(row);
 	itemid_t * m_item =
-		(itemid_t *) mem_allocator.alloc( sizeof(itemid_t), pid );
+		(itemid_t *) mem_allocator.alloc_load( sizeof(itemid_t), pid );
 	m_item->init();
 	m_item->type = DT_row;
 	m_item->location = row;
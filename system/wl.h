@@ -5,6 +5,7 @@
 class row_t;
 class table_t;
 class IndexHash;
+class IndexSimd;
 class index_btree;
 class Catalog;
 class lock_man;
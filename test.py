@@ -55,7 +55,8 @@ def run(test = '', job=None, numa=True):
 		app_flags = "-Ar -t1"
 	if test == 'conflict':
 		app_flags = "-Ac -t4"
-        if numa:
+        # PART_ALLOC places the partitions itself
+        if numa and not (job is not None and eval_arg(job, "PART_ALLOC")):
 	    os.system("numactl --interleave all ./rundb %s | tee temp.out" % app_flags)
         else:
             os.system("./rundb %s | tee temp.out" % app_flags)